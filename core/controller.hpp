@@ -2,8 +2,7 @@
 #define __CONTROLLER_HPP__
 #include "../interfaces/icontroller.hpp"
 #include "../utils/singlton.hpp"
-#include <boost/bind.hpp>
-using namespace boost; 
+#include "../utils/multiton.hpp"
 
 
 /**
@@ -32,19 +31,50 @@ using namespace boost;
  * The simplest way is to subclass </code>Facade</code>, 
  * and use its <code>initializeController</code> method to add your 
  * registrations. 
+ * <P>
+ * Like the <code>View</code>, the command table is published as an
+ * immutable snapshot, so <code>executeCommand</code> is safe to call from
+ * any thread without locking while registrations are serialised.
+ * <P>
+ * <code>Controller::getInstance(key)</code> returns the Multiton
+ * controller of the core named <code>key</code>; it registers its
+ * commands with <code>View::getInstance(key)</code>.
+ * <P>
+ * Commands registered with <code>registerAsyncCommand</code> run on a
+ * <code>WorkStealingPool</code>, by default the shared
+ * <code>WorkStealingPool::getInstance()</code>, so a slow command does
+ * not hold up the thread that sent the notification.
+ * <P>
+ * The <code>CommandFactory</code>s and <code>AsyncCommand</code>s the
+ * <code>Controller</code> creates belong to it: they are deleted when
+ * their registration is replaced or removed, once no
+ * <code>executeCommand</code> can still be running them.
  * */
 
 #include "../interfaces/icommand.hpp"
+#include "../patterns/command/command_factory.hpp"
+#include "../patterns/command/async_command.hpp"
 #include "../utils/hash_map.hpp"
 #include "../core/view.hpp"
+#include "../utils/epoch.hpp"
+#include <atomic>
+#include <mutex>
 
 using namespace HASH_MAP_NAMESPACE;
 
-class Controller  : public IController, public Singlton<Controller>
+class Controller  : public IController, public Singlton<Controller>, public Multiton<Controller>
 {
 
     public:
+        using Singlton<Controller>::getInstance; 
+        using Multiton<Controller>::getInstance; 
+        using Singlton<Controller>::destroyInstance; 
+        using Multiton<Controller>::destroyInstance; 
+        using Singlton<Controller>::hasInstance; 
+        using Multiton<Controller>::hasInstance; 
+
         Controller( )
+            :m_commandTable(new CommandTable()), m_executor(NULL)
         {
             //if (m_instance != NULL) 
             //    throw "Singlton error";
@@ -53,14 +83,55 @@ class Controller  : public IController, public Singlton<Controller>
             initializeController();	
         }
 
+        /**
+         * Constructor of the Multiton <code>Controller</code> of the
+         * core named <code>key</code>; call
+         * <code>Controller::getInstance(key)</code> instead.
+         */
+        explicit Controller( const std::string & key )
+            :m_commandTable(new CommandTable()), m_executor(NULL), m_multitonKey(key)
+        {
+            initializeController();	
+        }
+
         void initializeController()
         {
-            m_view = View::getInstance();
+            if (m_multitonKey.empty())
+                m_view = View::getInstance();
+            else
+                m_view = View::getInstance(m_multitonKey);
+        }
+
+        /**
+         * The key of the core this controller belongs to; empty for the Singleton.
+         */
+        const std::string & getMultitonKey() const
+        {
+            return m_multitonKey; 
+        }
+
+        virtual ~Controller()
+        {
+            try
+            {
+                flushCommands(); 
+            }
+            catch (...)
+            {
+                // nowhere to report a failed async command from here
+            }
+            delete m_commandTable.load(); 
+            for (size_t i = 0; i < m_owned.size(); i++)
+            {
+                delete m_owned[i].factory; 
+                if (m_owned[i].async != NULL)
+                    m_owned[i].async->release(); 
+            }
         }
 
     public:
-        typedef hash_map<std::string,ICommand * >  CommandMap; 
-        typedef CommandMap::iterator CommandMapItr; 
+        // Commands indexed by NotificationId
+        typedef std::vector<ICommand * >  CommandTable; 
         /**
          * <code>Controller</code> Singleton Factory method.
          * 
@@ -86,14 +157,14 @@ class Controller  : public IController, public Singlton<Controller>
          */
         virtual void executeCommand(const  INotification & note ) 
         {
-            CommandMapItr itr =  m_commandMap.find(note.getName()); 
-            if (itr != m_commandMap.end())
+            NotificationId id = NotificationIds::resolve(note); 
+            // held while the command runs: a command the Controller owns
+            // is only deleted once no guard can still see it
+            EpochDomain::Guard guard(m_epoch); 
+            ICommand * pCmd = getCommand(id); 
+            if (pCmd != NULL)
             {
-                ICommand * pCmd = itr->second; 
-                if (pCmd != NULL)
-                {
-                    pCmd->execute(note); 
-                }
+                pCmd->execute(note); 
             }
         }
 
@@ -114,14 +185,85 @@ class Controller  : public IController, public Singlton<Controller>
          */
         virtual void registerCommand( const std::string & notificationName ,ICommand * pCmd) 
         {
-            CommandMapItr itr = m_commandMap.find(notificationName); 
-            if (itr == m_commandMap.end())
+            registerOwned(notificationName, pCmd, Owned()); 
+        }
+
+        /**
+         * Register a command class as the handler for a particular
+         * <code>INotification</code>.
+         * 
+         * <P>
+         * A new <code>T</code> is created for every notification, so
+         * the command may keep per-execution state and may run on
+         * several threads at once. Instances are recycled through a
+         * <code>CommandFactory</code>.</P>
+         * 
+         * @param notificationName the name of the <code>INotification</code>
+         */
+        template <class T>
+        void registerCommand( const std::string & notificationName )
+        {
+            Owned owned; 
+            owned.factory = new CommandFactory<T>(); 
+            registerOwned(notificationName, owned.factory, owned);
+        }
+
+        /**
+         * Register an <code>ICommand</code> that is executed on the
+         * command executor instead of the thread sending the notification.
+         * 
+         * <P>
+         * The command gets a copy of the notification; see
+         * <code>AsyncCommand</code>. It may run on several workers at
+         * once.</P>
+         * 
+         * @param notificationName the name of the <code>INotification</code>
+         * @param pCmd the <code>ICommand</code> to run
+         */
+        virtual void registerAsyncCommand( const std::string & notificationName, ICommand * pCmd )
+        {
+            registerAsync(notificationName, pCmd, false); 
+        }
+
+        /**
+         * Register a command class that is instantiated and executed
+         * on the command executor for every notification.
+         * 
+         * @param notificationName the name of the <code>INotification</code>
+         */
+        template <class T>
+        void registerAsyncCommand( const std::string & notificationName )
+        {
+            registerAsync(notificationName, new CommandFactory<T>(), true); 
+        }
+
+        /**
+         * Set the pool async commands registered from now on run on.
+         * 
+         * @param pool the pool; NULL for <code>WorkStealingPool::getInstance()</code>
+         */
+        void setCommandExecutor( WorkStealingPool * pool )
+        {
+            std::lock_guard<std::mutex> lock(m_mutex); 
+            m_executor = pool; 
+        }
+
+        /**
+         * Wait until every async command queued so far has run, running
+         * queued tasks on the calling thread meanwhile.
+         * 
+         * @throws the first exception an async command threw since the last flush
+         */
+        virtual void flushCommands()
+        {
+            WorkStealingPool * executor = NULL; 
             {
-				NotifyMethod notifyMethod = boost::bind(&Controller::executeCommand,this,_1); 
-				NotifyContext notifyContext(this); 
-                m_view->registerObserver( notificationName, new Observer( notifyMethod, notifyContext) );
+                std::lock_guard<std::mutex> lock(m_mutex); 
+                executor = m_executor; 
             }
-            m_commandMap[ notificationName ] = pCmd;
+            if (executor != NULL)
+                executor->waitFor(m_async.inflight); 
+            m_async.rethrow(); 
         }
 
 
@@ -133,7 +275,9 @@ class Controller  : public IController, public Singlton<Controller>
 		 */
 		virtual bool hasCommand(const std::string &  notificationName ) 
 		{
-            return m_commandMap.find(notificationName) != m_commandMap.end(); 
+            NotificationId id = NotificationIds::getInstance()->getTypeIndex(notificationName); 
+            EpochDomain::Guard guard(m_epoch); 
+            return getCommand(id) != NULL; 
 		}
 
 
@@ -144,25 +288,134 @@ class Controller  : public IController, public Singlton<Controller>
 		 */
 		virtual void removeCommand( const std::string & notificationName  ) 
 		{
+			NotificationId id = NotificationIds::getInstance()->getTypeIndex(notificationName); 
+			std::lock_guard<std::mutex> lock(m_mutex); 
+
 			// if the Command is registered...
-			if ( hasCommand( notificationName ) )
+			if ( getCommand( id ) != NULL )
 			{
 				// remove the observer
-				NotifyContext notifyContext; 
-				m_view->removeObserver( notificationName, notifyContext);
+				m_view->removeObserver( m_subscriptions[id] );
+				m_subscriptions[id] = Subscription(); 
 							
 				// remove the command
-                m_commandMap.erase(notificationName); 
+                publishCommand(id, NULL, Owned()); 
 			}
 		}
 
 
-        // Local reference to View 
     protected:
+        // What the Controller created for one registration
+        struct Owned
+        {
+            Owned()
+                :factory(NULL), async(NULL)
+            {
+            }
+
+            // a CommandFactory registered directly
+            ICommand * factory; 
+            // an async wrapper; owns its factory, if any
+            AsyncCommand * async; 
+        };
+
+        void registerOwned( const std::string & notificationName, ICommand * pCmd, const Owned & owned )
+        {
+            NotificationId id = NotificationIds::getInstance()->registerType(notificationName); 
+
+            std::lock_guard<std::mutex> lock(m_mutex); 
+            if (getCommand(id) == NULL)
+            {
+				NotifyMethod notifyMethod = NotifyMethod::bind<Controller, &Controller::executeCommand>(this); 
+				NotifyContext notifyContext(this); 
+                if ((size_t)id >= m_subscriptions.size())
+                {
+                    m_subscriptions.resize(id + 1); 
+                }
+                m_subscriptions[id] = m_view->registerObserver( id, notifyMethod, notifyContext );
+            }
+            publishCommand(id, pCmd, owned);
+        }
+
+        void registerAsync( const std::string & notificationName, ICommand * pCmd, bool ownsCommand )
+        {
+            Owned owned; 
+            {
+                std::lock_guard<std::mutex> lock(m_mutex); 
+                if (m_executor == NULL)
+                    m_executor = WorkStealingPool::getInstance(); 
+                owned.async = new AsyncCommand(pCmd, m_executor, &m_async, ownsCommand); 
+            }
+            registerOwned(notificationName, owned.async, owned);
+        }
+
+        // Command registered for a notification id, or NULL.
+        // Callers hold either the mutex or an epoch guard.
+        ICommand * getCommand(NotificationId id) const
+        {
+            const CommandTable * table = m_commandTable.load(std::memory_order_acquire); 
+            if (id > 0 && (size_t)id < table->size())
+            {
+                return (*table)[id]; 
+            }
+            return NULL; 
+        }
+
+        // Replace the command of a notification id and retire what the
+        // Controller created for the old one; the mutex is held
+        void publishCommand(NotificationId id, ICommand * pCmd, const Owned & owned)
+        {
+            const CommandTable * current = m_commandTable.load(); 
+            CommandTable * table = new CommandTable(*current); 
+            if ((size_t)id >= table->size())
+            {
+                table->resize(id + 1, NULL); 
+            }
+            (*table)[id] = pCmd; 
+
+            m_commandTable.store(table, std::memory_order_release); 
+            m_epoch.retire(current); 
+
+            if ((size_t)id >= m_owned.size())
+            {
+                m_owned.resize(id + 1); 
+            }
+            Owned old = m_owned[id]; 
+            m_owned[id] = owned; 
+            m_epoch.retire(old.factory); 
+            // jobs already queued keep the wrapper alive past the grace period
+            if (old.async != NULL)
+                m_epoch.retire(new AsyncCommand::Reference(old.async)); 
+        }
+
+        // Local reference to View 
         IView * m_view  ;
 		
-		// Mapping of Notification names to Command Class references
-        hash_map<std::string,ICommand * >  m_commandMap; 
+		// Commands indexed by interned Notification name
+        std::atomic<const CommandTable *>  m_commandTable; 
+
+        // Reclaims retired command tables
+        EpochDomain m_epoch; 
+
+        // Serialises registerCommand and removeCommand
+        std::mutex m_mutex; 
+
+        // The View subscription of each command, indexed like the table;
+        // guarded by m_mutex
+        std::vector<Subscription> m_subscriptions; 
+
+        // Pool async commands are created for; guarded by m_mutex
+        WorkStealingPool * m_executor; 
+
+        // Async commands queued and not yet run, and what they threw
+        AsyncCommand::Tracker m_async; 
+
+        // What the Controller created for each registration, indexed
+        // like the table; guarded by m_mutex
+        std::vector<Owned> m_owned; 
+
+        // Key of the core, empty for the Singleton
+        std::string m_multitonKey; 
 
 		// Singleton instance
 		//static IController * m_instance ;
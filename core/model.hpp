@@ -1,7 +1,14 @@
 #ifndef __MODEL_HPP__
 #define __MODEL_HPP__
-#include "../utils/hash_map.hpp"
+#include <atomic>
+#include <mutex>
+#if defined(_MSC_VER) && defined(_WIN64)
+#include <intrin.h>
+#endif
+#include "../utils/hash_func.hpp"
+#include "../utils/epoch.hpp"
 #include "../utils/singlton.hpp"
+#include "../utils/multiton.hpp"
 
 
 /**
@@ -27,16 +34,53 @@
  * instances once the <code>Facade</code> has initialized the Core 
  * actors.</p>
  *
+ * <P>
+ * <code>Model::getInstance(key)</code> returns the Multiton model of
+ * the core named <code>key</code>.</P>
+ *
+ * <P>
+ * Proxies are looked up far more often than they are registered, so
+ * lookups take no lock and may run on any thread while registrations
+ * are serialised. Every proxy name gets an entry that lives as long as
+ * the model; the entry holds the registered proxy, or NULL, in an
+ * atomic. Names are found through an open-addressing table of entry
+ * pointers that writers fill in place and replace, under
+ * <code>EpochDomain</code> reclamation, only when it grows. Entries are
+ * also numbered in a directory of chunks that never move, so
+ * <code>retrieveProxy(ProxyHandle)</code> is two array indexings with
+ * no hashing and no epoch guard.</P>
+ *
  * @see org.puremvc.as3.patterns.proxy.Proxy Proxy
  * @see org.puremvc.as3.interfaces.IProxy IProxy
  */
 #include "../interfaces/imodel.hpp"
 
-class Model : public IModel, public Singlton<Model>
+class Model : public IModel, public Singlton<Model>, public Multiton<Model>
 {
     public:
+        using Singlton<Model>::getInstance; 
+        using Multiton<Model>::getInstance; 
+        using Singlton<Model>::destroyInstance; 
+        using Multiton<Model>::destroyInstance; 
+        using Singlton<Model>::hasInstance; 
+        using Multiton<Model>::hasInstance; 
+
+        virtual ~Model()
+        {
+            for (size_t c = 0; c < CHUNKS; ++c)
+            {
+                std::atomic<ProxyEntry *> * chunk = m_chunks[c].load(); 
+                if (chunk == NULL)
+                    continue; 
+                for (size_t i = 0; i < ((size_t)1 << c); ++i)
+                {
+                    delete chunk[i].load(); 
+                }
+                delete [] chunk; 
+            }
+            delete m_nameTable.load(); 
+        }
 
-        virtual ~Model(){}
         /**
          * Constructor. 
          * 
@@ -50,12 +94,33 @@ class Model : public IModel, public Singlton<Model>
          * 
          */
         Model()
+            :m_nameTable(new NameTable(16)), m_entries(1)
         {
+            for (size_t c = 0; c < CHUNKS; ++c)
+                m_chunks[c].store(NULL, std::memory_order_relaxed); 
             initializeModel();	
         }
-    public:
-        typedef hash_map<std::string,IProxy * > PROXY_MAP; 
-        typedef PROXY_MAP::iterator  PROXY_MAP_ITR; 
+
+        /**
+         * Constructor of the Multiton <code>Model</code> of the core
+         * named <code>key</code>; call <code>Model::getInstance(key)</code>
+         * instead.
+         */
+        explicit Model( const std::string & key )
+            :m_nameTable(new NameTable(16)), m_entries(1), m_multitonKey(key)
+        {
+            for (size_t c = 0; c < CHUNKS; ++c)
+                m_chunks[c].store(NULL, std::memory_order_relaxed); 
+            initializeModel();	
+        }
+
+        /**
+         * The key of the core this model belongs to; empty for the Singleton.
+         */
+        const std::string & getMultitonKey() const
+        {
+            return m_multitonKey; 
+        }
 
         /**
          * Initialize the Singleton <code>Model</code> instance.
@@ -73,11 +138,6 @@ class Model : public IModel, public Singlton<Model>
         {
         }
 
-        /**
-         * <code>Model</code> Singleton Factory method.
-         * 
-         * @return the Singleton instance
-         */
     public:
 
         /**
@@ -87,7 +147,11 @@ class Model : public IModel, public Singlton<Model>
          */
         void registerProxy( IProxy * proxy ) 
         {
-            m_proxyMap[ proxy->getName() ] = proxy;
+            std::string name = proxy->getName(); 
+            {
+                std::lock_guard<std::mutex> lock(m_mutex); 
+                intern(name, hashString(name))->proxy.store(proxy, std::memory_order_release); 
+            }
             proxy->onRegister();
         }
 
@@ -99,12 +163,58 @@ class Model : public IModel, public Singlton<Model>
          */
         IProxy *retrieveProxy( const std::string & proxyName)
         {
-            PROXY_MAP_ITR itr = m_proxyMap.find(proxyName); 
-            if (itr != m_proxyMap.end())
+            size_t hash = hashString(proxyName); 
+            EpochDomain::Guard guard(m_epoch); 
+            ProxyEntry * entry = find(proxyName, hash); 
+            return entry != NULL ? entry->proxy.load(std::memory_order_acquire) : NULL; 
+        }
+
+        /**
+         * Get the handle of a proxy name, whether or not a proxy is
+         * registered under it yet.
+         * 
+         * @param proxyName
+         * @return the handle to pass to <code>retrieveProxy</code>.
+         */
+        ProxyHandle getProxyHandle( const std::string & proxyName)
+        {
+            size_t hash = hashString(proxyName); 
             {
-                return itr->second; 
+                EpochDomain::Guard guard(m_epoch); 
+                ProxyEntry * entry = find(proxyName, hash); 
+                if (entry != NULL)
+                    return ProxyHandle(entry->index); 
             }
-            return NULL; 
+            std::lock_guard<std::mutex> lock(m_mutex); 
+            return ProxyHandle(intern(proxyName, hash)->index); 
+        }
+
+        /**
+         * Retrieve an <code>IProxy</code> from the <code>Model</code> by handle.
+         * 
+         * @param handle a handle returned by <code>getProxyHandle</code>
+         * @return the <code>IProxy</code> currently registered under the handle's name, or NULL.
+         */
+        IProxy *retrieveProxy( const ProxyHandle & handle)
+        {
+            ProxyEntry * entry = getEntry(handle.index); 
+            return entry != NULL ? entry->proxy.load(std::memory_order_acquire) : NULL; 
+        }
+
+        /**
+         * Retrieve a proxy by handle as the class it was registered as.
+         * 
+         * <P>
+         * <code>T</code> must be the class of the registered proxy or
+         * one of its bases; the pointer is not checked.</P>
+         * 
+         * @param handle a handle returned by <code>getProxyHandle</code>
+         * @return the proxy currently registered under the handle's name, or NULL.
+         */
+        template <class T>
+        T * retrieveProxy( const ProxyHandle & handle)
+        {
+            return static_cast<T *>(retrieveProxy(handle)); 
         }
 
         /**
@@ -115,7 +225,7 @@ class Model : public IModel, public Singlton<Model>
          */
         bool hasProxy( const std::string & proxyName)  
         {
-            return m_proxyMap.end() !=  m_proxyMap.find(proxyName); 
+            return retrieveProxy(proxyName) != NULL; 
         }
 
         /**
@@ -126,21 +236,177 @@ class Model : public IModel, public Singlton<Model>
          */
         IProxy *removeProxy( const std::string & proxyName) 
         {
+            size_t hash = hashString(proxyName); 
+            std::lock_guard<std::mutex> lock(m_mutex); 
+            ProxyEntry * entry = find(proxyName, hash); 
+            if (entry == NULL)
+                return NULL; 
+            return entry->proxy.exchange(NULL, std::memory_order_acq_rel); 
+        }
+
+    protected:
+        // chunk c of the entry directory holds indices [2^c, 2^(c+1))
+        enum { CHUNKS = 48 }; 
+
+        // A proxy name and whatever is registered under it; never freed
+        // while the model lives
+        struct ProxyEntry
+        {
+            ProxyEntry(const std::string & n, size_t h, size_t i)
+                :name(n), hash(h), index(i), proxy(NULL)
+            {
+            }
+
+            std::string name; 
+            size_t hash; 
+            size_t index; 
+            std::atomic<IProxy *> proxy; 
+        };
 
-            PROXY_MAP_ITR itr = m_proxyMap.find(proxyName); 
-            IProxy * proxy = NULL; 
-            if (itr != m_proxyMap.end())
+        // Open-addressing table of entries by name, at most half full;
+        // filled in place by writers and replaced when it grows
+        struct NameTable
+        {
+            explicit NameTable(size_t capacity)
+                :mask(capacity - 1), size(0), buckets(new std::atomic<ProxyEntry *>[capacity])
             {
-                proxy = itr->second; 
-                m_proxyMap.erase(itr); 
+                for (size_t i = 0; i < capacity; ++i)
+                    buckets[i].store(NULL, std::memory_order_relaxed); 
+            }
+
+            ~NameTable()
+            {
+                delete [] buckets; 
+            }
+
+            // the caller holds the mutex
+            void insert(ProxyEntry * entry)
+            {
+                size_t i = entry->hash & mask; 
+                while (buckets[i].load(std::memory_order_relaxed) != NULL)
+                    i = (i + 1) & mask; 
+                buckets[i].store(entry, std::memory_order_release); 
+                ++size; 
+            }
+
+            size_t mask; 
+            // written under the mutex only
+            size_t size; 
+            std::atomic<ProxyEntry *> * buckets; 
+
+            private:
+                NameTable(const NameTable &); 
+                NameTable & operator = (const NameTable &); 
+        };
+
+        // Entry of a name; callers hold either the mutex or an epoch guard
+        ProxyEntry * find(const std::string & name, size_t hash) const
+        {
+            const NameTable * table = m_nameTable.load(std::memory_order_acquire); 
+            for (size_t i = hash & table->mask; ; i = (i + 1) & table->mask)
+            {
+                ProxyEntry * entry = table->buckets[i].load(std::memory_order_acquire); 
+                if (entry == NULL)
+                    return NULL; 
+                if (entry->hash == hash && entry->name == name)
+                    return entry; 
             }
-            return proxy;
         }
 
-        // Mapping of proxyNames to IProxy instances
-    protected:
-        PROXY_MAP m_proxyMap ;
-        // Message Constants
+        // Chunk holding a non-zero handle index: its highest set bit
+        static size_t chunkOf(size_t index)
+        {
+#if defined(__GNUC__)
+            return 63 - __builtin_clzll((unsigned long long)index); 
+#elif defined(_MSC_VER) && defined(_WIN64)
+            unsigned long bit; 
+            _BitScanReverse64(&bit, index); 
+            return bit; 
+#else
+            size_t bit = 0; 
+            while (index >>= 1)
+                ++bit; 
+            return bit; 
+#endif
+        }
+
+        // Entry of a handle index, or NULL
+        ProxyEntry * getEntry(size_t index) const
+        {
+            if (index == 0)
+                return NULL; 
+            size_t chunk = chunkOf(index); 
+            if (chunk >= CHUNKS)
+                return NULL; 
+            std::atomic<ProxyEntry *> * entries = m_chunks[chunk].load(std::memory_order_acquire); 
+            if (entries == NULL)
+                return NULL; 
+            return entries[index - ((size_t)1 << chunk)].load(std::memory_order_acquire); 
+        }
+
+        // Entry of a name, created if needed; the mutex is held
+        ProxyEntry * intern(const std::string & name, size_t hash)
+        {
+            ProxyEntry * entry = find(name, hash); 
+            if (entry != NULL)
+                return entry; 
+
+            size_t index = m_entries++; 
+            size_t chunk = chunkOf(index); 
+            std::atomic<ProxyEntry *> * entries = m_chunks[chunk].load(std::memory_order_relaxed); 
+            if (entries == NULL)
+            {
+                size_t length = (size_t)1 << chunk; 
+                entries = new std::atomic<ProxyEntry *>[length]; 
+                for (size_t i = 0; i < length; ++i)
+                    entries[i].store(NULL, std::memory_order_relaxed); 
+                m_chunks[chunk].store(entries, std::memory_order_release); 
+            }
+            entry = new ProxyEntry(name, hash, index); 
+            entries[index - ((size_t)1 << chunk)].store(entry, std::memory_order_release); 
+
+            NameTable * table = m_nameTable.load(std::memory_order_relaxed); 
+            if (2 * (table->size + 1) > table->mask + 1)
+            {
+                NameTable * grown = new NameTable(2 * (table->mask + 1)); 
+                for (size_t i = 0; i <= table->mask; ++i)
+                {
+                    ProxyEntry * moved = table->buckets[i].load(std::memory_order_relaxed); 
+                    if (moved != NULL)
+                        grown->insert(moved); 
+                }
+                grown->insert(entry); 
+                m_nameTable.store(grown, std::memory_order_release); 
+                m_epoch.retire(table); 
+            }
+            else
+            {
+                table->insert(entry); 
+            }
+            return entry; 
+        }
+
+        // Entries by name
+        std::atomic<NameTable *> m_nameTable; 
+
+        // Entries by handle index
+        std::atomic<std::atomic<ProxyEntry *> *> m_chunks[CHUNKS]; 
+
+        // Reclaims name tables replaced by a bigger one
+        EpochDomain m_epoch; 
+
+        // Serialises registerProxy, removeProxy and new handles
+        std::mutex m_mutex; 
+
+        // The next handle index; guarded by m_mutex
+        size_t m_entries; 
+
+        // Key of the core, empty for the Singleton
+        std::string m_multitonKey; 
+
+    private:
+        Model(const Model &); 
+        Model & operator = (const Model &); 
 };
 
 #endif // 
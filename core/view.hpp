@@ -2,9 +2,10 @@
 #define __VIEW_HPP__
 #include "../utils/hash_map.hpp"
 #include <list>
+#include <algorithm>
 #include <vector>
-#include <boost/bind.hpp>
-using namespace boost; 
+#include <atomic>
+#include <mutex>
 
 
 
@@ -23,6 +24,25 @@ using namespace boost;
  * <LI>Notifying the <code>IObservers</code> of a given <code>INotification</code> when it broadcast.</LI>
  * </UL>
  * 
+ * <P>
+ * <code>notifyObservers</code> may be called from any thread and never
+ * takes a lock: the observer lists are immutable snapshots published
+ * through an atomic pointer and reclaimed by an <code>EpochDomain</code>.
+ * Registering and removing observers and mediators is serialised by
+ * a mutex.</P>
+ * 
+ * <P>
+ * Names opted into coalescing are looked up in a table published the
+ * same way, so names that are not coalesced pay one load per
+ * notification. Pending coalesced notifications sit behind a separate
+ * mutex and are delivered outside it.</P>
+ * 
+ * <P>
+ * Besides the Singleton, a <code>View</code> can be a Multiton:
+ * <code>View::getInstance(key)</code> returns the view of the core
+ * named <code>key</code>, which shares no observers, mediators or
+ * locks with any other core.</P>
+ * 
  * @see org.puremvc.as3.patterns.mediator.Mediator Mediator
  * @see org.puremvc.as3.patterns.observer.Observer Observer
  * @see org.puremvc.as3.patterns.observer.Notification Notification
@@ -30,11 +50,16 @@ using namespace boost;
 
 #include "../interfaces/iview.hpp"
 #include "../patterns/observer/obversver.hpp"
+#include "../patterns/observer/observer_record.hpp"
+#include "../patterns/observer/notification_ids.hpp"
+#include "../patterns/observer/notification.hpp"
 #include "../patterns/mediator/mediator.hpp"
 #include "../utils/singlton.hpp"
+#include "../utils/multiton.hpp"
+#include "../utils/epoch.hpp"
 
 using namespace HASH_MAP_NAMESPACE;
-class View : public IView, public Singlton<View>
+class View : public IView, public Singlton<View>, public Multiton<View>
 {
 
     /**
@@ -50,22 +75,99 @@ class View : public IView, public Singlton<View>
      * 
      */
     public:
-		typedef hash_map<std::string, IMediator * > MediatorMap; 
+        // A registered mediator and the subscriptions made for its interests
+        struct MediatorEntry
+        {
+            MediatorEntry()
+                :mediator(NULL)
+            {
+            }
+
+            IMediator * mediator; 
+            std::vector<Subscription> subscriptions; 
+        };
+
+		typedef hash_map<std::string, MediatorEntry > MediatorMap; 
 		typedef MediatorMap::iterator MediatorMapItr; 
 
-        typedef std::vector<IObserver*>  ObserverArray; 
+        // Subscribers are stored by value, so fanning out walks one
+        // contiguous array of records
+        typedef std::vector<ObserverRecord>  ObserverArray; 
         typedef ObserverArray::iterator ObserverArrayItr; 
 
-        typedef hash_map<std::string, ObserverArray >  ObserverMap; 
-        typedef ObserverMap::iterator ObserverMapItr; 
+        // Observer lists indexed by NotificationId. A published table and
+        // the lists it points to are never modified; writers copy, publish
+        // and retire, so a dispatch in progress keeps its snapshot
+        typedef std::vector<const ObserverArray * >  ObserverTable; 
+
+        // How a name opted into coalescing is merged
+        struct CoalesceRule
+        {
+            CoalesceRule()
+                :enabled(false), byType(false), merge(NULL)
+            {
+            }
+
+            bool enabled; 
+            bool byType; 
+            CoalesceMerge merge; 
+        };
+
+        // Coalescing rules indexed by NotificationId, published like ObserverTable
+        typedef std::vector<CoalesceRule>  CoalesceTable; 
+
+        // A notification held back by coalescing. Only the body pointer
+        // is copied; typed notifications are never held back
+        struct PendingNotification
+        {
+            PendingNotification(const INotification & notification, std::chrono::steady_clock::time_point since)
+                :notification(NotificationIds::resolve(notification), 
+                        const_cast<INotification &>(notification).getBody(), notification.getType()), 
+                 since(since)
+            {
+            }
+
+            Notification notification; 
+            std::chrono::steady_clock::time_point since; 
+        };
+        typedef std::vector<PendingNotification> PendingNotifications; 
+
+        using Singlton<View>::getInstance; 
+        using Multiton<View>::getInstance; 
+        using Singlton<View>::destroyInstance; 
+        using Multiton<View>::destroyInstance; 
+        using Singlton<View>::hasInstance; 
+        using Multiton<View>::hasInstance; 
 
         View( )
+            :m_observerTable(new ObserverTable()), m_coalesceTable(new CoalesceTable()), 
+             m_nextSerial(1), m_coalescingWindow(0)
         {
             //if (m_instance != NULL) throw "singleton error";
             //m_instance = this;
             initializeView();	
         }
 
+        /**
+         * Constructor of the Multiton <code>View</code> of the core
+         * named <code>key</code>; call <code>View::getInstance(key)</code>
+         * instead.
+         */
+        explicit View( const std::string & key )
+            :m_observerTable(new ObserverTable()), m_coalesceTable(new CoalesceTable()), 
+             m_nextSerial(1), m_coalescingWindow(0), m_multitonKey(key)
+        {
+            initializeView();	
+        }
+
+        /**
+         * The key of the core this view belongs to; empty for the Singleton.
+         */
+        const std::string & getMultitonKey() const
+        {
+            return m_multitonKey; 
+        }
+
         /**
          * Initialize the Singleton View instance.
          * 
@@ -81,6 +183,17 @@ class View : public IView, public Singlton<View>
         {
         }
 
+        virtual ~View()
+        {
+            const ObserverTable * table = m_observerTable.load(); 
+            for (size_t i = 0; i < table->size(); i++)
+            {
+                delete (*table)[i]; 
+            }
+            delete table; 
+            delete m_coalesceTable.load(); 
+        }
+
         /**
          * View Singleton Factory method.
          * 
@@ -103,18 +216,39 @@ class View : public IView, public Singlton<View>
          */
         virtual void registerObserver ( const std::string & notificationName, IObserver * observer) 
         {
+            registerObserver(NotificationIds::getInstance()->registerType(notificationName), observer); 
+        }
 
-            ObserverMapItr itr = m_observerMap.find(notificationName); 
-            if (itr != m_observerMap.end())
-            {
-                itr->second.push_back(observer); 
-            }
-            else  
-            {
-                ObserverArray observers; 
-                observers.push_back(observer); 
-                m_observerMap[notificationName] = observers; 
-            }
+        /**
+         * Register an <code>IObserver</code> for an interned notification name.
+         * 
+         * @param notificationId the id of the <code>INotifications</code> to notify this <code>IObserver</code> of
+         * @param observer the <code>IObserver</code> to register
+         */
+        virtual void registerObserver ( NotificationId notificationId, IObserver * observer) 
+        {
+            addObserver(notificationId, ObserverRecord::fromObserver(observer)); 
+        }
+
+        /**
+         * Register a method to be called for an interned notification name.
+         * 
+         * <P>
+         * Unlike registering an <code>IObserver</code>, nothing is
+         * allocated per subscriber: the method is stored inline in the
+         * observer list.</P>
+         * 
+         * @param notificationId the id of the <code>INotifications</code> to call the method for
+         * @param notifyMethod the method to call
+         * @param notifyContext the context to remove the subscription by
+         * @param priority observers with a higher priority are notified first
+         * @return the handle to pass to <code>removeObserver</code>
+         */
+        virtual Subscription registerObserver ( NotificationId notificationId, const NotifyMethod & notifyMethod, const NotifyContext & notifyContext, int priority = 0) 
+        {
+            ObserverRecord record = ObserverRecord::fromMethod(notifyMethod, notifyContext); 
+            record.priority = priority; 
+            return addObserver(notificationId, record); 
         }
 
 		/**
@@ -125,63 +259,239 @@ class View : public IView, public Singlton<View>
 		*/
 		void removeObserver( const std::string & notificationName,NotifyContext &notifyContext)
 		{
+			removeObserver(NotificationIds::getInstance()->getTypeIndex(notificationName), notifyContext); 
+		}
+
+		void removeObserver( NotificationId notificationId,NotifyContext &notifyContext)
+		{
+			std::lock_guard<std::recursive_mutex> lock(m_mutex); 
+
 			// the observer list for the notification under inspection
-			ObserverMapItr itr = m_observerMap.find(notificationName); 
-			if (itr  != m_observerMap.end()) 
+			const ObserverArray * current = getObservers(notificationId); 
+			if (current != NULL) 
 			{
-				ObserverArray observers = itr->second;//cloned
-
 				// find the observer for the notifyContext
-				for ( ObserverArrayItr oitr = observers.begin(); oitr != observers.end(); ++oitr) 
+				for ( size_t i = 0; i < current->size(); i++ ) 
 				{
-
-					//Observer observer(NotifyMethod(),notifyContext); 
-					//if ( observer.compareNotifyContext( notifyContext ) == true ) 
-					//{
-					//	// there can only be one Observer for a given notifyContext 
-					//	// in any given Observer list, so remove it and break
-					//	observers.erase(oitr);
-					//	break;
-					//}
-
+					// there can only be one Observer for a given notifyContext 
+					// in any given Observer list, so remove it and break
+					if ( (*current)[i].matches( notifyContext ) ) 
+					{
+						eraseObserver(notificationId, *current, i); 
+						break; 
+					}
 				}
+			}
+		} 
 
-				// Also, when a Notification's Observer list length falls to 
-				// zero, delete the notification key from the observer map
-				if ( observers.empty()) 
+		/**
+		* Cancel one subscription.
+		* <P>
+		* Observer lists are immutable snapshots, so this publishes a copy
+		* of the one list the subscription is in without it; nothing else
+		* is searched or copied.</P>
+		* 
+		* @param subscription the handle returned when the observer was registered
+		* @return false if the subscription was already removed
+		*/
+		virtual bool removeObserver( const Subscription & subscription )
+		{
+			std::lock_guard<std::recursive_mutex> lock(m_mutex); 
+
+			const ObserverArray * current = getObservers(subscription.id); 
+			if (current != NULL) 
+			{
+				for ( size_t i = 0; i < current->size(); i++ ) 
 				{
-					m_observerMap.erase(notificationName);
+					if ( (*current)[i].serial == subscription.serial ) 
+					{
+						eraseObserver(subscription.id, *current, i); 
+						return true; 
+					}
 				}
 			}
-		} 
+			return false; 
+		}
 
         /**
          * Notify the <code>IObservers</code> for a particular <code>INotification</code>.
          * 
          * <P>
          * All previously attached <code>IObservers</code> for this <code>INotification</code>'s
-         * list are notified and are passed a reference to the <code>INotification</code> in 
-         * the order in which they were registered.</P>
+         * list are notified and are passed a reference to the <code>INotification</code> 
+         * from the highest priority down, and in the order in which they
+         * were registered within a priority. An observer may call
+         * <code>stopPropagation</code> to end the notification there.</P>
          * 
          * @param notification the <code>INotification</code> to notify <code>IObservers</code> of.
          */
         virtual void notifyObservers( const INotification &notification) 
         {
-            ObserverMapItr itr = m_observerMap.find(notification.getName()); 
-            if (itr != m_observerMap.end())
+            NotificationId id = NotificationIds::resolve(notification); 
+
+            // Pin the current observer list rather than copying it;
+            // registrations during the notification loop publish a new
+            // list and leave this snapshot untouched
+            EpochDomain::Guard guard(m_epoch); 
+            const CoalesceRule * rule = getCoalesceRule(id); 
+            if (rule != NULL)
+            {
+                coalesce(*rule, notification); 
+                return; 
+            }
+            dispatch(id, notification); 
+        }
+
+        virtual void coalesceNotifications( NotificationId notificationId, CoalesceMerge merge = NULL, bool byType = false) 
+        {
+            if (notificationId <= 0)
+                return; 
+            CoalesceRule rule; 
+            rule.enabled = true; 
+            rule.byType = byType; 
+            rule.merge = merge; 
+            std::lock_guard<std::recursive_mutex> lock(m_mutex); 
+            publishCoalesceRule(notificationId, rule); 
+        }
+
+        virtual void stopCoalescing( NotificationId notificationId) 
+        {
+            if (notificationId <= 0)
+                return; 
+            {
+                std::lock_guard<std::recursive_mutex> lock(m_mutex); 
+                publishCoalesceRule(notificationId, CoalesceRule()); 
+            }
+            PendingNotifications ready; 
+            takePending(notificationId, ready); 
+            deliver(ready); 
+        }
+
+        virtual void setCoalescingWindow( std::chrono::microseconds window) 
+        {
+            std::lock_guard<std::mutex> lock(m_pendingMutex); 
+            m_coalescingWindow = window; 
+        }
+
+        virtual size_t flushCoalesced() 
+        {
+            PendingNotifications ready; 
+            {
+                std::lock_guard<std::mutex> lock(m_pendingMutex); 
+                ready.swap(m_pending); 
+            }
+            return deliverPending(ready); 
+        }
+
+        virtual size_t flushExpiredCoalesced( std::chrono::steady_clock::time_point now ) 
+        {
+            PendingNotifications ready; 
+            {
+                std::lock_guard<std::mutex> lock(m_pendingMutex); 
+                if (m_pending.empty() || m_coalescingWindow.count() <= 0 || 
+                        now - m_pending.front().since < m_coalescingWindow)
+                {
+                    return 0; 
+                }
+                ready.swap(m_pending); 
+            }
+            return deliverPending(ready); 
+        }
+
+        /**
+         * Stop the notification being dispatched on this thread.
+         * 
+         * <P>
+         * Called by an observer, typically a high priority mediator that
+         * has consumed the notification; the observers after it in the
+         * list are not notified. In a batch, the rest of the observers
+         * skip the whole run of notifications with that name.</P>
+         */
+        static void stopPropagation()
+        {
+            propagationStopped() = true; 
+        }
+
+        /**
+         * Check if any <code>IObserver</code> is registered for a notification id.
+         *
+         * <P>
+         * Like <code>notifyObservers</code> this takes no lock.</P>
+         *
+         * @param id the interned name of the notification
+         * @return whether notifying <code>id</code> would reach an observer.
+         */
+        bool hasObservers( NotificationId id ) const
+        {
+            EpochDomain::Guard guard(m_epoch); 
+            const ObserverArray * observers = getObservers(id); 
+            return observers != NULL && !observers->empty(); 
+        }
+
+        /**
+         * Notify the <code>IObservers</code> of a batch of <code>INotification</code>s.
+         * 
+         * <P>
+         * The batch is bucketed by <code>NotificationId</code> with a
+         * counting sort, which keeps the batch order within each id and
+         * is linear since ids are dense. Every observer list is then
+         * pinned once per name and each observer gets the whole run of
+         * notifications for that name in a single call.</P>
+         * 
+         * @param batch the notifications to notify <code>IObservers</code> of.
+         */
+        virtual void notifyObservers( const NotificationBatch & batch) 
+        {
+            std::vector<NotificationId> ids(batch.size()); 
+            NotificationId maxId = 0; 
+            for (size_t i = 0; i < batch.size(); i++)
+            {
+                ids[i] = NotificationIds::resolve(*batch[i]); 
+                maxId = std::max(maxId, ids[i]); 
+            }
+
+            // starts[id] is where the run of id begins in sorted
+            std::vector<size_t> starts(maxId + 2, 0); 
+            for (size_t i = 0; i < ids.size(); i++)
+            {
+                starts[ids[i] + 1]++; 
+            }
+            for (NotificationId id = 0; id <= maxId; id++)
+            {
+                starts[id + 1] += starts[id]; 
+            }
+            NotificationBatch sorted(batch.size()); 
+            std::vector<size_t> next(starts.begin(), starts.end() - 1); 
+            for (size_t i = 0; i < batch.size(); i++)
+            {
+                sorted[next[ids[i]]++] = batch[i]; 
+            }
+
+            EpochDomain::Guard guard(m_epoch); 
+            for (NotificationId id = 1; id <= maxId; id++)
             {
+                size_t begin = starts[id], end = starts[id + 1]; 
+                if (begin == end)
+                    continue; 
 
-                // Copy observers from reference array to working array, 
-                // since the reference array may change during the notification loop
-                
-                // Get a reference to the observers list for this notification name
-                ObserverArray observers = itr->second;
+                const CoalesceRule * rule = getCoalesceRule(id); 
+                if (rule != NULL)
+                {
+                    for (size_t i = begin; i < end; i++)
+                    {
+                        coalesce(*rule, *sorted[i]); 
+                    }
+                    continue; 
+                }
 
-                // Notify Observers from the working array				
-                for (size_t i = 0; i < observers.size(); i++) 
+                const ObserverArray * observers = getObservers(id); 
+                if (observers != NULL)
                 {
-                    IObserver * pObserver = observers[i];
-                    pObserver->notifyObserver( notification );
+                    PropagationScope scope; 
+                    for (size_t i = 0; i < observers->size() && !scope.stopped(); i++) 
+                    {
+                        (*observers)[i].notify( &sorted[begin], end - begin );
+                    }
                 }
             }
         }
@@ -215,12 +525,15 @@ class View : public IView, public Singlton<View>
          */
         virtual void registerMediator( IMediator * mediator ) 
         {
+            std::unique_lock<std::recursive_mutex> lock(m_mutex); 
+
             // do not allow re-registration (you must to removeMediator fist)
 			if (m_mediatorMap.find(mediator->getName()) != m_mediatorMap.end())
 				return; 
 
             // Register the Mediator for retrieval by name
-            m_mediatorMap[ mediator->getName() ] = mediator;
+            MediatorEntry & entry = m_mediatorMap[ mediator->getName() ];
+            entry.mediator = mediator; 
 
             // Get Notification interests, if any.
 			Interests interests= mediator->listNotificationInterests();
@@ -228,18 +541,22 @@ class View : public IView, public Singlton<View>
             // Register Mediator as an observer for each of its notification interests
             if ( !interests.empty()) 
             {
-                // Create Observer referencing this mediator's handlNotification method
-                //var observer:Observer = new Observer( mediator->handleNotification, mediator );
-				NotifyMethod notifyMethod = boost::bind(&IMediator::handleNotification,mediator,_1);
-				NotifyContext notifyContext(this); 
-				Observer * observer  = new Observer(notifyMethod,notifyContext); 
-
-                // Register Mediator as Observer for its list of Notification interests
+                // Create an observer record referencing this mediator's handleNotification method
+				NotifyContext notifyContext(mediator); 
+				ObserverRecord record = ObserverRecord::fromMediator(mediator, notifyContext); 
+				record.priority = mediator->getPriority(); 
+
+                // Register Mediator as Observer for its list of Notification interests,
+                // keeping the handles to remove it by
+                std::vector<Subscription> subscriptions; 
                 for ( size_t i =0;  i<interests.size(); i++ ) 
 				{
-                    registerObserver( interests[i],  observer );
+                    subscriptions.push_back( addObserver( NotificationIds::getInstance()->registerType(interests[i]), record ) );
                 }			
+                // the map may have been rehashed by a reentrant registration
+                m_mediatorMap[ mediator->getName() ].subscriptions.swap(subscriptions); 
             }
+            lock.unlock(); 
 
             // alert the mediator that it has been registered
             mediator->onRegister();
@@ -253,10 +570,11 @@ class View : public IView, public Singlton<View>
          */
         virtual IMediator * retrieveMediator( const std::string & mediatorName) 
         {
+			std::lock_guard<std::recursive_mutex> lock(m_mutex); 
 			MediatorMapItr itr = m_mediatorMap.find(mediatorName); 
 			if(itr != m_mediatorMap.end())
 			{
-				return itr->second; 
+				return itr->second.mediator; 
 			}
 			return NULL;
         }
@@ -269,25 +587,27 @@ class View : public IView, public Singlton<View>
          */
         virtual IMediator * removeMediator( const std::string & mediatorName) 
         {
+            std::unique_lock<std::recursive_mutex> lock(m_mutex); 
+
             // Retrieve the named mediator
 			MediatorMapItr itr = m_mediatorMap.find(mediatorName); 
 
 			IMediator * mediator = NULL;
             if ( itr != m_mediatorMap.end()) 
             {
-				mediator = itr->second; 
+				mediator = itr->second.mediator; 
                 // for every notification this mediator is interested in...
-				Interests interests= mediator->listNotificationInterests();
-                for ( size_t i =0; i<interests.size(); i++ ) 
+				const std::vector<Subscription> & subscriptions = itr->second.subscriptions; 
+                for ( size_t i =0; i<subscriptions.size(); i++ ) 
                 {
                     // remove the observer linking the mediator 
                     // to the notification interest					
-					NotifyContext notifyContext(mediator); 
-                    removeObserver( interests[i], notifyContext);
+                    removeObserver( subscriptions[i] );
                 }	
 
                 // remove the mediator from the map		
 				m_mediatorMap.erase(mediatorName);
+				lock.unlock(); 
 
                 // alert the mediator that it has been removed
                 mediator->onRemove();
@@ -303,15 +623,290 @@ class View : public IView, public Singlton<View>
          */
         bool hasMediator( const std::string & mediatorName) 
         {
+			std::lock_guard<std::recursive_mutex> lock(m_mutex); 
 			return m_mediatorMap.find(mediatorName) != m_mediatorMap.end(); 
         }
 
-        // Mapping of Mediator names to Mediator instances
     protected:
+        // Notify the observers of id from the current snapshot; the
+        // caller holds an epoch guard
+        void dispatch(NotificationId id, const INotification & notification)
+        {
+            const ObserverArray * observers = getObservers(id); 
+            if (observers != NULL)
+            {
+                // Notify Observers from the snapshot
+                PropagationScope scope; 
+                const ObserverRecord * records = observers->data(); 
+                for (size_t i = 0; i < observers->size() && !scope.stopped(); i++) 
+                {
+                    records[i].notify( notification );
+                }
+            }
+        }
+
+        // Deliver notifications taken off the pending list
+        void deliver(const PendingNotifications & ready)
+        {
+            EpochDomain::Guard guard(m_epoch); 
+            for (size_t i = 0; i < ready.size(); i++)
+            {
+                dispatch(ready[i].notification.getId(), ready[i].notification); 
+            }
+        }
+
+        // Deliver what was taken from m_pending, then hand the storage
+        // back so the next burst does not allocate
+        size_t deliverPending(PendingNotifications & ready)
+        {
+            deliver(ready); 
+            size_t count = ready.size(); 
+            ready.clear(); 
+            std::lock_guard<std::mutex> lock(m_pendingMutex); 
+            if (m_pending.empty())
+            {
+                m_pending.swap(ready); 
+            }
+            return count; 
+        }
+
+        // Move the pending notifications of an id to ready
+        void takePending(NotificationId id, PendingNotifications & ready)
+        {
+            std::lock_guard<std::mutex> lock(m_pendingMutex); 
+            PendingNotifications kept; 
+            for (size_t i = 0; i < m_pending.size(); i++)
+            {
+                if (m_pending[i].notification.getId() == id)
+                    ready.push_back(m_pending[i]); 
+                else
+                    kept.push_back(m_pending[i]); 
+            }
+            m_pending.swap(kept); 
+        }
+
+        // Fold a notification into the pending list; once the oldest
+        // pending notification is older than the window, deliver them all
+        void coalesce(const CoalesceRule & rule, const INotification & notification)
+        {
+            NotificationId id = NotificationIds::resolve(notification); 
+            PendingNotifications ready; 
+            if (notification.getBodyTag() != NULL)
+            {
+                // a typed body lives inside the notification, which the
+                // pending copy cannot keep; deliver what is pending for
+                // the name first, then this one at once
+                takePending(id, ready); 
+                for (size_t i = 0; i < ready.size(); i++)
+                {
+                    dispatch(ready[i].notification.getId(), ready[i].notification); 
+                }
+                dispatch(id, notification); 
+                return; 
+            }
+            {
+                std::lock_guard<std::mutex> lock(m_pendingMutex); 
+                // without a window the arrival time is never looked at
+                std::chrono::steady_clock::time_point now; 
+                if (m_coalescingWindow.count() > 0)
+                {
+                    now = std::chrono::steady_clock::now(); 
+                }
+
+                size_t i = 0; 
+                for (; i < m_pending.size(); i++)
+                {
+                    const Notification & pending = m_pending[i].notification; 
+                    if (pending.getId() == id && (!rule.byType || pending.getType() == notification.getType()))
+                        break; 
+                }
+                if (i == m_pending.size())
+                {
+                    m_pending.push_back(PendingNotification(notification, now)); 
+                }
+                else if (rule.merge != NULL)
+                {
+                    rule.merge(m_pending[i].notification, notification); 
+                }
+                else
+                {
+                    m_pending[i].notification.setBody(const_cast<INotification &>(notification).getBody()); 
+                    m_pending[i].notification.setType(notification.getType()); 
+                }
+
+                if (m_coalescingWindow.count() > 0 && now - m_pending.front().since >= m_coalescingWindow)
+                {
+                    ready.swap(m_pending); 
+                }
+            }
+            for (size_t i = 0; i < ready.size(); i++)
+            {
+                dispatch(ready[i].notification.getId(), ready[i].notification); 
+            }
+        }
+
+        // Coalescing rule of a notification id, or NULL if it is not
+        // coalesced. Callers hold either the mutex or an epoch guard.
+        const CoalesceRule * getCoalesceRule(NotificationId id) const
+        {
+            const CoalesceTable * table = m_coalesceTable.load(std::memory_order_acquire); 
+            if (id > 0 && (size_t)id < table->size() && (*table)[id].enabled)
+            {
+                return &(*table)[id]; 
+            }
+            return NULL; 
+        }
+
+        // Replace the coalescing rule of a notification id; the mutex is held
+        void publishCoalesceRule(NotificationId id, const CoalesceRule & rule)
+        {
+            const CoalesceTable * current = m_coalesceTable.load(); 
+            CoalesceTable * table = new CoalesceTable(*current); 
+            if ((size_t)id >= table->size())
+            {
+                table->resize(id + 1); 
+            }
+            (*table)[id] = rule; 
+
+            m_coalesceTable.store(table, std::memory_order_release); 
+            m_epoch.retire(current); 
+        }
+
+        // Whether stopPropagation was called in the innermost dispatch of this thread
+        static bool & propagationStopped()
+        {
+            static thread_local bool s_stopped = false; 
+            return s_stopped; 
+        }
+
+        // Clears the stop flag for one dispatch loop and restores the
+        // enclosing loop's flag afterwards, even if an observer throws
+        class PropagationScope
+        {
+            public:
+                PropagationScope()
+                    :m_stopped(propagationStopped()), m_outer(m_stopped)
+                {
+                    m_stopped = false; 
+                }
+
+                ~PropagationScope()
+                {
+                    m_stopped = m_outer; 
+                }
+
+                bool stopped() const
+                {
+                    return m_stopped; 
+                }
+
+            private:
+                bool & m_stopped; 
+                bool m_outer; 
+        };
+
+        // Insert a record into the observer list of an id, after every
+        // record of the same or a higher priority
+        Subscription addObserver(NotificationId notificationId, const ObserverRecord & record)
+        {
+            if (notificationId <= 0)
+                return Subscription(); 
+
+            std::lock_guard<std::recursive_mutex> lock(m_mutex); 
+
+            // copy on write, never touch a published list
+            const ObserverArray * current = getObservers(notificationId); 
+            ObserverArray * observers = new ObserverArray(); 
+            observers->reserve((current ? current->size() : 0) + 1); 
+            if (current != NULL)
+            {
+                observers->assign(current->begin(), current->end()); 
+            }
+            size_t position = observers->size(); 
+            while (position > 0 && (*observers)[position - 1].priority < record.priority)
+            {
+                position--; 
+            }
+            ObserverArrayItr inserted = observers->insert(observers->begin() + position, record); 
+            inserted->serial = m_nextSerial++; 
+            publishObservers(notificationId, observers); 
+            return Subscription(notificationId, inserted->serial); 
+        }
+
+        // Publish the list of an id without its record at index; the mutex is held
+        void eraseObserver(NotificationId notificationId, const ObserverArray & current, size_t index)
+        {
+            if (current.size() == 1)
+            {
+                // clear the notification slot when its list falls to zero
+                publishObservers(notificationId, NULL); 
+                return; 
+            }
+            ObserverArray * observers = new ObserverArray(); 
+            observers->reserve(current.size() - 1); 
+            observers->insert(observers->end(), current.begin(), current.begin() + index); 
+            observers->insert(observers->end(), current.begin() + index + 1, current.end()); 
+            publishObservers(notificationId, observers); 
+        }
+
+        // Current observer list for a notification id, or NULL.
+        // Callers hold either the mutex or an epoch guard.
+        const ObserverArray * getObservers(NotificationId id) const
+        {
+            const ObserverTable * table = m_observerTable.load(std::memory_order_acquire); 
+            if (id > 0 && (size_t)id < table->size())
+            {
+                return (*table)[id]; 
+            }
+            return NULL; 
+        }
+
+        // Replace the observer list of a notification id; the mutex is held
+        void publishObservers(NotificationId id, const ObserverArray * observers)
+        {
+            const ObserverTable * current = m_observerTable.load(); 
+            ObserverTable * table = new ObserverTable(*current); 
+            if ((size_t)id >= table->size())
+            {
+                table->resize(id + 1, NULL); 
+            }
+            const ObserverArray * old = (*table)[id]; 
+            (*table)[id] = observers; 
+
+            m_observerTable.store(table, std::memory_order_release); 
+            m_epoch.retire(current); 
+            m_epoch.retire(old); 
+        }
+
+        // Mapping of Mediator names to Mediator instances
 		MediatorMap m_mediatorMap ;
 
-        // Mapping of Notification names to Observer lists
-        ObserverMap m_observerMap	;
+        // Observer lists indexed by interned Notification name
+        std::atomic<const ObserverTable *> m_observerTable	;
+
+        // Coalescing rules indexed by interned Notification name
+        std::atomic<const CoalesceTable *> m_coalesceTable; 
+
+        // Reclaims retired observer tables and lists
+        EpochDomain m_epoch; 
+
+        // Serialises writers of both maps
+        std::recursive_mutex m_mutex; 
+
+        // Serial of the next subscription; guarded by m_mutex
+        size_t m_nextSerial; 
+
+        // Coalesced notifications not delivered yet, oldest first
+        PendingNotifications m_pending; 
+
+        // Longest time a notification stays pending; guarded by m_pendingMutex
+        std::chrono::microseconds m_coalescingWindow; 
+
+        // Guards m_pending and m_coalescingWindow; never held while notifying
+        std::mutex m_pendingMutex; 
+
+        // Key of the core, empty for the Singleton
+        std::string m_multitonKey; 
 
         // Singleton instance
         //static IView * m_instance;
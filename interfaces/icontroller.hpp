@@ -14,6 +14,19 @@ class IController
         virtual void removeCommand(const std::string & notificationName) =0; 
 
         virtual bool hasCommand(const std::string & notificationName) =0; 
+
+        /**
+         * Register an <code>ICommand</code> that is executed on a worker
+         * thread instead of the thread sending the notification.
+         */
+        virtual void registerAsyncCommand(const std::string & notificationName, ICommand * ) =0; 
+
+        /**
+         * Wait until every async command queued so far has run.
+         * 
+         * @throws the first exception an async command threw since the last flush
+         */
+        virtual void flushCommands() =0; 
 };
 
 #endif // 
@@ -30,6 +30,37 @@ class IMediator
 
         virtual void handleNotification(const INotification&  notification) =0; 
 
+        /**
+         * Handle a run of notifications with the same name.
+         * 
+         * <P>
+         * Called when notifications are sent with <code>sendNotifications</code>.
+         * Override to process a whole batch at once; by default each
+         * notification goes to <code>handleNotification</code>.</P>
+         * 
+         * @param notifications the notifications, in the order they were sent
+         * @param count number of notifications
+         */
+        virtual void handleNotifications(const INotification * const * notifications, size_t count)
+        {
+            for (size_t i = 0; i < count; ++i)
+            {
+                handleNotification(*notifications[i]); 
+            }
+        }
+
+        /**
+         * Priority of this mediator's observers.
+         * 
+         * <P>
+         * Observers with a higher priority are notified first; the
+         * default is 0. Read once, when the mediator is registered.</P>
+         */
+        virtual int getPriority()
+        {
+            return 0; 
+        }
+
         virtual void onRegister() = 0;
 		
         virtual void onRemove()  = 0; 
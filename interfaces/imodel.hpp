@@ -1,8 +1,39 @@
 #ifndef __IMODEL_HPP__
 #define __IMODEL_HPP__
 #include <string>
+#include <cstddef>
 #include "./iproxy.hpp"
 
+/**
+ * Handle of a proxy name registered with an <code>IModel</code>.
+ *
+ * <P>
+ * A handle is taken once with <code>getProxyHandle</code> and stays
+ * valid for the life of the model, whether or not a proxy is currently
+ * registered under its name, so hot paths can look the proxy up again
+ * by index instead of by name.</P>
+ */
+struct ProxyHandle
+{
+    ProxyHandle()
+        :index(0)
+    {
+    }
+
+    explicit ProxyHandle(size_t i)
+        :index(i)
+    {
+    }
+
+    bool isValid() const
+    {
+        return index != 0;
+    }
+
+    // Position of the name in the model's registry, never 0
+    size_t index;
+};
+
 class IModel 
 {
 public:
@@ -23,6 +54,23 @@ public:
      */
     virtual IProxy * retrieveProxy( const std::string & proxyName)=0 ;
 
+    /**
+     * Get the handle of a proxy name, whether or not a proxy is
+     * registered under it yet.
+     * 
+     * @param proxyName
+     * @return the handle to pass to <code>retrieveProxy</code>.
+     */
+    virtual ProxyHandle getProxyHandle( const std::string & proxyName) =0;
+
+    /**
+     * Retrieve an <code>IProxy</code> instance from the Model by handle.
+     * 
+     * @param handle a handle returned by <code>getProxyHandle</code>
+     * @return the <code>IProxy</code> currently registered under the handle's name, or NULL.
+     */
+    virtual IProxy * retrieveProxy( const ProxyHandle & handle) =0;
+
     /**
      * Remove an <code>IProxy</code> instance from the Model.
      * 
@@ -1,7 +1,23 @@
 #ifndef __INOTIFICATION_HPP__
 #define __INOTIFICATION_HPP__
 #include <string>
+#include <cstddef>
+#include <vector>
 
+/**
+ * Dense integer id of an interned notification name.
+ * 
+ * <P>
+ * Ids are handed out by <code>NotificationIds</code>; 0 means the
+ * name has not been interned.</P>
+ */
+typedef int NotificationId; 
+
+/**
+ * Identifies the C++ type of a typed notification body; see
+ * <code>TypedNotification</code>. NULL for untyped bodies.
+ */
+typedef const void * BodyTag; 
 
 class INotification
 {
@@ -13,8 +29,21 @@ public:
     /**
      * Get the name of the <code>INotification</code> instance. 
      * No setter, should be set by constructor only
+     * 
+     * <P>
+     * Returned by reference so that lookups and handler comparisons
+     * do not copy the name on every dispatch.</P>
      */
-    virtual std::string getName() const  =0;
+    virtual const std::string & getName() const  =0;
+
+    /**
+     * Get the interned id of the <code>INotification</code> name,
+     * or 0 if the implementation does not carry one.
+     */
+    virtual NotificationId getId() const
+    {
+        return 0; 
+    }
 
     /**
      * Set the body of the <code>INotification</code> instance
@@ -26,6 +55,24 @@ public:
      */
     virtual void * getBody()=0;
 
+    /**
+     * Get the hash of the name as computed by <code>hashString</code>,
+     * or 0 if the implementation does not precompute it.
+     */
+    virtual size_t getNameHash() const
+    {
+        return 0; 
+    }
+
+    /**
+     * Get the tag of the body's C++ type, or NULL if the body is an
+     * untyped <code>void*</code>.
+     */
+    virtual BodyTag getBodyTag() const
+    {
+        return NULL; 
+    }
+
     /**
      * Set the type of the <code>INotification</code> instance
      */
@@ -34,7 +81,7 @@ public:
     /**
      * Get the type of the <code>INotification</code> instance
      */
-    virtual std::string getType() =0;
+    virtual const std::string & getType() const =0;
 
     /**
      * Get the string representation of the <code>INotification</code> instance
@@ -42,6 +89,11 @@ public:
     virtual std::string toString() =0;
 };
 
+/**
+ * Notifications sent together with <code>sendNotifications</code>.
+ */
+typedef std::vector<const INotification *> NotificationBatch; 
+
 
 
 #endif // 
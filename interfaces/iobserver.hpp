@@ -34,6 +34,24 @@ public:
 	*/
 	virtual void notifyObserver( const INotification & notification)=0;
 
+	/**
+	* Notify the interested object of several notifications with the same name.
+	* 
+	* <P>
+	* Called by the batched <code>notifyObservers</code>; by default
+	* each notification is passed on in turn.</P>
+	* 
+	* @param notifications the notifications, in the order they were sent
+	* @param count number of notifications
+	*/
+	virtual void notifyObserver( const INotification * const * notifications, size_t count)
+	{
+		for (size_t i = 0; i < count; ++i)
+		{
+			notifyObserver(*notifications[i]);
+		}
+	}
+
 	/**
 	* Compare the given object to the notificaiton context object.
 	* 
@@ -43,6 +61,37 @@ public:
 	virtual bool compareNotifyContext( NotifyContext & context)=0;
 };
 
+/**
+ * Identifies one subscription in the <code>View</code>.
+ *
+ * <P>
+ * Returned when a subscription is registered and passed back to
+ * <code>removeObserver</code> to cancel exactly that subscription.</P>
+ */
+struct Subscription
+{
+    Subscription()
+        :id(0), serial(0)
+    {
+    }
+
+    Subscription(NotificationId i, size_t s)
+        :id(i), serial(s)
+    {
+    }
+
+    bool isValid() const
+    {
+        return serial != 0;
+    }
+
+    // The notification subscribed to
+    NotificationId id;
+
+    // Unique among all subscriptions of the View, never 0
+    size_t serial;
+};
+
 
 
 #endif //
@@ -2,9 +2,16 @@
 #define __IVIEW_HPP__
 
 #include <string>
+#include <chrono>
 #include "iobserver.hpp"
 #include "imediator.hpp"
 
+/**
+ * Folds a notification into a pending one of the same name while it
+ * is being coalesced; see <code>IView::coalesceNotifications</code>.
+ */
+typedef void (*CoalesceMerge)(INotification & pending, const INotification & incoming); 
+
 class IView 
 {
 
@@ -19,6 +26,26 @@ public:
      */
     virtual void registerObserver( const std::string & notificationName,IObserver *observer) =0;
 
+    /**
+     * Register an <code>IObserver</code> for an interned notification name.
+     * 
+     * @param notificationId the id of the <code>INotifications</code> to notify this <code>IObserver</code> of
+     * @param observer the <code>IObserver</code> to register
+     */
+    virtual void registerObserver( NotificationId notificationId,IObserver *observer) =0;
+
+    /**
+     * Register a method to be called for an interned notification name,
+     * without an <code>IObserver</code> object.
+     * 
+     * @param notificationId the id of the <code>INotifications</code> to call the method for
+     * @param notifyMethod the method to call
+     * @param notifyContext the context to remove the subscription by
+     * @param priority observers with a higher priority are notified first
+     * @return the handle to pass to <code>removeObserver</code>
+     */
+    virtual Subscription registerObserver( NotificationId notificationId,const NotifyMethod & notifyMethod,const NotifyContext & notifyContext, int priority = 0) =0;
+
     /**
      * Remove a group of observers from the observer list for a given Notification name.
      * <P>
@@ -27,13 +54,25 @@ public:
      */
     virtual void removeObserver( const std::string & notificationName,NotifyContext & notifyContext) =0;
 
+    virtual void removeObserver( NotificationId notificationId,NotifyContext & notifyContext) =0;
+
+    /**
+     * Cancel the subscription a <code>registerObserver</code> call returned.
+     * 
+     * @param subscription the handle of the subscription
+     * @return false if the subscription was already removed
+     */
+    virtual bool removeObserver( const Subscription & subscription) =0;
+
     /**
      * Notify the <code>IObservers</code> for a particular <code>INotification</code>.
      * 
      * <P>
      * All previously attached <code>IObservers</code> for this <code>INotification</code>'s
-     * list are notified and are passed a reference to the <code>INotification</code> in 
-     * the order in which they were registered.</P>
+     * list are notified and are passed a reference to the <code>INotification</code>,
+     * highest priority first and in the order in which they were
+     * registered within a priority. A notification whose name is being
+     * coalesced is held back and delivered merged.</P>
      * 
      * @param notification the <code>INotification</code> to notify <code>IObservers</code> of.
      */
@@ -41,6 +80,84 @@ public:
 
 	virtual void notifyObservers(const INotification & notification,ObserverMediators &obers) =0;
 
+    /**
+     * Notify the <code>IObservers</code> of a batch of <code>INotification</code>s.
+     * 
+     * <P>
+     * The batch is grouped by name: each observer list is looked up
+     * once per name and every observer receives all notifications with
+     * that name in one call, in the order they appear in the batch.
+     * Notifications with different names are not delivered in batch
+     * order.</P>
+     * 
+     * @param batch the notifications to notify <code>IObservers</code> of.
+     */
+    virtual void notifyObservers( const NotificationBatch & batch) =0;
+
+    /**
+     * Coalesce notifications with a given name.
+     * 
+     * <P>
+     * From now on <code>notifyObservers</code> does not deliver such a
+     * notification at once. It is kept pending, and every later one
+     * with the same name, and the same type if <code>byType</code>, is
+     * folded into it by <code>merge</code>, which by default keeps the
+     * latest body and type. The pending notifications are delivered,
+     * once each, by <code>flushCoalesced</code>, or once the
+     * coalescing window has passed by the next notification to arrive
+     * or by <code>flushExpiredCoalesced</code>, whichever comes first.
+     * Notifications sent in a batch are coalesced the same way.</P>
+     * 
+     * <P>
+     * A pending notification keeps only the body pointer, so an untyped
+     * body must stay valid until the flush that delivers it. A
+     * notification with a typed body (<code>getBodyTag</code> not NULL),
+     * such as one from <code>sendTypedNotification</code>, carries its
+     * body inside itself and is never held back: whatever is pending for
+     * its name is delivered first, then it is delivered at once.</P>
+     * 
+     * @param notificationId the id of the <code>INotifications</code> to coalesce
+     * @param merge folds an incoming notification into the pending one
+     * @param byType whether notifications with different types are kept apart
+     */
+    virtual void coalesceNotifications( NotificationId notificationId, CoalesceMerge merge = NULL, bool byType = false) =0;
+
+    /**
+     * Stop coalescing a name; what is pending for it is delivered.
+     * 
+     * @param notificationId the id passed to <code>coalesceNotifications</code>
+     */
+    virtual void stopCoalescing( NotificationId notificationId) =0;
+
+    /**
+     * How long a notification may stay pending; zero, the default,
+     * holds it until <code>flushCoalesced</code>.
+     * 
+     * @param window the longest time between the first notification
+     * pending and its delivery, checked whenever a notification arrives
+     * and by <code>flushExpiredCoalesced</code>
+     */
+    virtual void setCoalescingWindow( std::chrono::microseconds window) =0;
+
+    /**
+     * Deliver every pending coalesced notification.
+     * 
+     * @return the number of notifications delivered
+     */
+    virtual size_t flushCoalesced() =0;
+
+    /**
+     * Deliver every pending coalesced notification if the oldest has
+     * been pending for the coalescing window by <code>now</code>.
+     * 
+     * <P>
+     * Called on every tick of a <code>NotificationTimer</code>, so a
+     * burst is delivered on time even if nothing is sent after it.</P>
+     * 
+     * @return the number of notifications delivered
+     */
+    virtual size_t flushExpiredCoalesced( std::chrono::steady_clock::time_point now) =0;
+
     /**
      * Register an <code>IMediator</code> instance with the <code>View</code>.
      * 
@@ -1,6 +1,6 @@
 #ifndef __NOTIFYMETHOD_HPP__
 #define __NOTIFYMETHOD_HPP__
-#include <boost/function.hpp>
+#include <cstddef>
 
 #include "notify_context.hpp"
 
@@ -24,7 +24,103 @@ private:
 */
 
 
-typedef boost::function<void (const INotification & )> NotifyMethod; 
+class INotification; 
+
+/**
+ * The callback an <code>Observer</code> invokes: a member function bound
+ * to an object.
+ * 
+ * <P>
+ * A <code>NotifyMethod</code> is just the object pointer and a pointer to
+ * a small thunk that the compiler generates for the bound member
+ * function, so it is trivially copyable, never allocates and calls the
+ * target with a single indirect call.</P>
+ * 
+ * <listing>
+ *		NotifyMethod method = NotifyMethod::bind<IMediator, &IMediator::handleNotification>( mediator );
+ *		method( notification );
+ * </listing>
+ */
+class NotifyMethod 
+{
+public:
+	typedef void (*Thunk)(void * object, const INotification & notification); 
+
+	NotifyMethod()
+		:m_object(NULL), m_thunk(NULL)
+	{
+	}
+
+	/**
+	 * Bind member function <code>M</code> of <code>object</code>.
+	 * Virtual member functions are called virtually.
+	 */
+	template <class C, void (C::*M)(const INotification &)>
+	static NotifyMethod bind(C * object)
+	{
+		return NotifyMethod(object, &invokeMember<C, M>); 
+	}
+
+	/**
+	 * Bind a free function; it gets no object.
+	 */
+	template <void (*F)(const INotification &)>
+	static NotifyMethod bind()
+	{
+		return NotifyMethod(NULL, &invokeFunction<F>); 
+	}
+
+	void operator () (const INotification & notification) const
+	{
+		m_thunk(m_object, notification); 
+	}
+
+	operator bool () const
+	{
+		return m_thunk != NULL; 
+	}
+
+	bool operator ! () const
+	{
+		return m_thunk == NULL; 
+	}
+
+	bool operator == (const NotifyMethod & other) const
+	{
+		return m_object == other.m_object && m_thunk == other.m_thunk; 
+	}
+
+	void * getObject() const
+	{
+		return m_object; 
+	}
+
+	Thunk getThunk() const
+	{
+		return m_thunk; 
+	}
+
+private:
+	NotifyMethod(void * object, Thunk thunk)
+		:m_object(object), m_thunk(thunk)
+	{
+	}
+
+	template <class C, void (C::*M)(const INotification &)>
+	static void invokeMember(void * object, const INotification & notification)
+	{
+		(static_cast<C *>(object)->*M)(notification); 
+	}
+
+	template <void (*F)(const INotification &)>
+	static void invokeFunction(void *, const INotification & notification)
+	{
+		F(notification); 
+	}
+
+	void * m_object; 
+	Thunk m_thunk; 
+};
 
 
 #endif // 
@@ -0,0 +1,198 @@
+#ifndef __ASYNC_COMMAND_HPP__
+#define __ASYNC_COMMAND_HPP__
+
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include "../../interfaces/icommand.hpp"
+#include "../../utils/object_pool.hpp"
+#include "../../utils/work_stealing_pool.hpp"
+#include "../observer/notification.hpp"
+#include "../observer/notification_ids.hpp"
+
+/**
+ * An <code>ICommand</code> that runs another one on a
+ * <code>WorkStealingPool</code> instead of the sending thread.
+ *
+ * <P>
+ * <code>execute</code> copies the notification's resolved id, body
+ * pointer and type into a job and returns at once; a pool worker then
+ * executes the wrapped command with the copy. Only the body pointer is copied,
+ * so what it points to must outlive the command, and the in-place
+ * body of a <code>TypedNotification</code> is not carried over. Jobs
+ * come from an <code>ObjectPool</code>, so once warm a dispatch does
+ * not allocate.</P>
+ *
+ * <P>
+ * The wrapped command may run on several workers at once; register a
+ * <code>CommandFactory</code> to get a fresh instance per notification.
+ * Pool tasks must not throw, so an exception from the command is
+ * caught on the worker and kept by the <code>Tracker</code>, if any.
+ * Usually created by <code>Controller::registerAsyncCommand</code>.</P>
+ *
+ * <P>
+ * Every queued job holds a reference to the wrapper. An owner that
+ * gives up its own reference with <code>release</code> instead of
+ * deleting the wrapper lets jobs still queued finish with it; the last
+ * reference deletes it.</P>
+ */
+class AsyncCommand : public ICommand
+{
+    public:
+        /**
+         * Counts the jobs of a group of <code>AsyncCommand</code>s and
+         * keeps the first exception one of them threw.
+         */
+        struct Tracker
+        {
+            Tracker()
+                :inflight(0)
+            {
+            }
+
+            /**
+             * Rethrow the first exception kept since the last call, if any.
+             */
+            void rethrow()
+            {
+                std::exception_ptr caught;
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    caught.swap(error);
+                }
+                if (caught)
+                    std::rethrow_exception(caught);
+            }
+
+            // jobs queued and not yet run
+            std::atomic<size_t> inflight;
+            // guards error
+            std::mutex mutex;
+            std::exception_ptr error;
+        };
+
+        /**
+         * Releases one reference to an <code>AsyncCommand</code> when deleted,
+         * so the release can be retired to an <code>EpochDomain</code>.
+         */
+        struct Reference
+        {
+            explicit Reference(AsyncCommand * command)
+                :command(command)
+            {
+            }
+
+            ~Reference()
+            {
+                command->release();
+            }
+
+            AsyncCommand * command;
+        };
+
+        /**
+         * @param command the command to run on the pool
+         * @param pool the pool to run it on
+         * @param tracker counts the jobs and keeps exceptions; may be NULL, which drops them
+         * @param ownsCommand whether deleting the wrapper deletes <code>command</code>
+         */
+        AsyncCommand(ICommand * command, WorkStealingPool * pool, Tracker * tracker = NULL, bool ownsCommand = false)
+            :m_command(command), m_pool(pool), m_tracker(tracker), m_ownsCommand(ownsCommand), m_references(1)
+        {
+        }
+
+        virtual ~AsyncCommand()
+        {
+            if (m_ownsCommand)
+                delete m_command;
+        }
+
+        /**
+         * Give up the owner's reference; the wrapper is deleted once no
+         * queued job needs it any more.
+         */
+        void release()
+        {
+            if (m_references.fetch_sub(1, std::memory_order_acq_rel) == 1)
+                delete this;
+        }
+
+        virtual void execute(const INotification & notification)
+        {
+            Job * job = getJobs().construct();
+            job->owner = this;
+            // resolved like executeCommand does, so a notification built
+            // before its name was registered keeps its name
+            NotificationId id = NotificationIds::resolve(notification);
+            void * body = const_cast<INotification &>(notification).getBody();
+            if (id != 0)
+                job->notification = Notification(id, body, notification.getType());
+            else
+                job->notification = Notification(notification.getName(), body, notification.getType());
+            m_references.fetch_add(1, std::memory_order_relaxed);
+            if (m_tracker != NULL)
+                m_tracker->inflight.fetch_add(1);
+            m_pool->submit(&AsyncCommand::run, job);
+        }
+
+        ICommand * getCommand() const
+        {
+            return m_command;
+        }
+
+    private:
+        struct Job
+        {
+            Job()
+                :owner(NULL), notification(NotificationId(0))
+            {
+            }
+
+            AsyncCommand * owner;
+            Notification notification;
+        };
+
+        static ObjectPool<Job> & getJobs()
+        {
+            static ObjectPool<Job> s_jobs;
+            return s_jobs;
+        }
+
+        static void run(void * argument)
+        {
+            Job * job = static_cast<Job *>(argument);
+            AsyncCommand * owner = job->owner;
+            Tracker * tracker = owner->m_tracker;
+            try
+            {
+                owner->m_command->execute(job->notification);
+            }
+            catch (...)
+            {
+                if (tracker != NULL)
+                {
+                    std::lock_guard<std::mutex> lock(tracker->mutex);
+                    if (!tracker->error)
+                        tracker->error = std::current_exception();
+                }
+            }
+            getJobs().destroy(job);
+            owner->release();
+            // last, whether or not the command threw: flushCommands may
+            // return as soon as inflight reaches zero
+            if (tracker != NULL)
+                tracker->inflight.fetch_sub(1, std::memory_order_release);
+        }
+
+        AsyncCommand(const AsyncCommand &);
+        AsyncCommand & operator = (const AsyncCommand &);
+
+        ICommand * m_command;
+        WorkStealingPool * m_pool;
+        Tracker * m_tracker;
+        bool m_ownsCommand;
+        // the owner's and one per queued job
+        std::atomic<size_t> m_references;
+};
+
+#endif //
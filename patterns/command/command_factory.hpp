@@ -0,0 +1,79 @@
+#ifndef __COMMAND_FACTORY_HPP__
+#define __COMMAND_FACTORY_HPP__
+
+#include "../../interfaces/icommand.hpp"
+#include "../../utils/object_pool.hpp"
+
+/**
+ * An <code>ICommand</code> that runs a new <code>T</code> for every notification.
+ *
+ * <P>
+ * Registering a single command instance means every notification,
+ * from every thread, runs the same object, so it cannot keep state
+ * for one execution. A <code>CommandFactory</code> is registered in
+ * its place and, like the original PureMVC, instantiates the command
+ * class each time: <code>T</code> is default constructed, executed and
+ * destroyed. The storage comes from an <code>ObjectPool</code> shared
+ * by all factories of <code>T</code>, so once the pool has warmed up
+ * executing a command does not allocate.</P>
+ *
+ * <P>
+ * Usually registered through <code>registerCommand&lt;T&gt;</code>:</P>
+ *
+ * <listing>
+ *		facade->registerCommand<StartupCommand>( STARTUP );
+ * </listing>
+ */
+template <class T>
+class CommandFactory : public ICommand
+{
+    public:
+        CommandFactory()
+            :m_pool(getPool())
+        {
+        }
+
+        virtual void execute(const INotification & notification)
+        {
+            Instance command(m_pool);
+            command->execute(notification);
+        }
+
+        /**
+         * The pool shared by every <code>CommandFactory&lt;T&gt;</code>.
+         */
+        static ObjectPool<T> & getPool()
+        {
+            static ObjectPool<T> s_pool;
+            return s_pool;
+        }
+
+    private:
+        // Returns the command to the pool even if execute throws
+        class Instance
+        {
+            public:
+                explicit Instance(ObjectPool<T> & pool)
+                    :m_pool(pool), m_command(pool.construct())
+                {
+                }
+
+                ~Instance()
+                {
+                    m_pool.destroy(m_command);
+                }
+
+                T * operator -> () const
+                {
+                    return m_command;
+                }
+
+            private:
+                ObjectPool<T> & m_pool;
+                T * m_command;
+        };
+
+        ObjectPool<T> & m_pool;
+};
+
+#endif //
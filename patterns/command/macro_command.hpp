@@ -2,6 +2,8 @@
 #define __MACRO_COMMAND_HPP__
 #include <string>
 #include <vector>
+#include "../../interfaces/icommand.hpp"
+#include "../../patterns/observer/notifier.hpp"
 
 class MacroCommand :public Notifier ,public ICommand
 {
@@ -77,7 +79,7 @@ class MacroCommand :public Notifier ,public ICommand
          * 
          * @param notification the <code>INotification</code> object to be passsed to each <i>SubCommand</i>.
          */
-        void execute( notification:INotification ) 
+        virtual void execute( const INotification & notification ) 
         {
             for (SubCommands::iterator itr = m_subCommands.begin(); itr != m_subCommands.end(); ++itr)
             {
@@ -0,0 +1,188 @@
+#ifndef __PARALLEL_MACRO_COMMAND_HPP__
+#define __PARALLEL_MACRO_COMMAND_HPP__
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+#include "../../interfaces/icommand.hpp"
+#include "../../patterns/observer/notifier.hpp"
+#include "../../utils/work_stealing_pool.hpp"
+
+/**
+ * A <code>MacroCommand</code> whose <i>SubCommands</i> run in parallel
+ * as far as their dependencies allow.
+ *
+ * <P>
+ * Each <i>SubCommand</i> is added with the indices of the ones it must
+ * run after. Dependencies can only name earlier <i>SubCommands</i>, so
+ * the graph is acyclic by construction. <code>execute</code> submits
+ * every <i>SubCommand</i> without dependencies to a
+ * <code>WorkStealingPool</code>; when one finishes, each dependent whose
+ * last dependency it was becomes ready. The finishing worker runs one
+ * newly ready <i>SubCommand</i> itself and submits the rest, so chains
+ * stay on one thread while independent branches are stolen by idle
+ * workers.</P>
+ *
+ * <P>
+ * <code>execute</code> returns when every <i>SubCommand</i> has run.
+ * The calling thread runs pool tasks while it waits, so a
+ * <code>ParallelMacroCommand</code> may itself be a <i>SubCommand</i>.
+ * If <i>SubCommands</i> throw, the rest of the graph still runs and
+ * the first exception is rethrown from <code>execute</code>.</P>
+ *
+ * <listing>
+ *		ParallelMacroCommand * startup = new ParallelMacroCommand();
+ *		size_t config = startup->addSubCommand( new LoadConfigCommand() );
+ *		size_t assets = startup->addSubCommand( new LoadAssetsCommand() );
+ *		size_t after[] = { config, assets };
+ *		startup->addSubCommand( new ShowMainViewCommand(), std::vector<size_t>( after, after + 2 ) );
+ * </listing>
+ */
+class ParallelMacroCommand :public Notifier ,public ICommand
+{
+
+    public:
+        /**
+         * @param pool the pool to run on; NULL for <code>WorkStealingPool::getInstance()</code>
+         */
+        explicit ParallelMacroCommand( WorkStealingPool * pool = NULL )
+            :m_pool(pool)
+        {
+        }
+
+        /**
+         * Add a <i>SubCommand</i>.
+         *
+         * @param pCmd the <code>ICommand</code> to run
+         * @param after indices of <i>SubCommands</i> that must finish first
+         * @return the index of the new <i>SubCommand</i>
+         * @throws std::invalid_argument if <code>after</code> names a <i>SubCommand</i> not added yet
+         */
+        size_t addSubCommand( ICommand * pCmd, const std::vector<size_t> & after = std::vector<size_t>() )
+        {
+            size_t index = m_nodes.size();
+            for (size_t i = 0; i < after.size(); ++i)
+            {
+                if (after[i] >= index)
+                    throw std::invalid_argument("ParallelMacroCommand: a sub-command can only depend on earlier ones");
+            }
+            Node node;
+            node.command = pCmd;
+            node.dependencies = 0;
+            for (size_t i = 0; i < after.size(); ++i)
+            {
+                m_nodes[after[i]].dependents.push_back(index);
+                ++node.dependencies;
+            }
+            m_nodes.push_back(node);
+            return index;
+        }
+
+        /**
+         * Execute the <i>SubCommands</i>, each after its dependencies.
+         *
+         * @param notification the <code>INotification</code> passed to each <i>SubCommand</i>.
+         */
+        virtual void execute( const INotification & notification )
+        {
+            if (m_nodes.empty())
+                return;
+            WorkStealingPool * pool = m_pool != NULL ? m_pool : WorkStealingPool::getInstance();
+
+            Run run(this, pool, notification);
+            for (size_t i = 0; i < m_nodes.size(); ++i)
+            {
+                run.tasks[i].run = &run;
+                run.tasks[i].index = i;
+                run.tasks[i].waiting.store(m_nodes[i].dependencies, std::memory_order_relaxed);
+            }
+            for (size_t i = 0; i < m_nodes.size(); ++i)
+            {
+                if (m_nodes[i].dependencies == 0)
+                    pool->submit(&ParallelMacroCommand::runTask, &run.tasks[i]);
+            }
+            pool->waitFor(run.remaining);
+            if (run.error)
+                std::rethrow_exception(run.error);
+        }
+
+    private:
+        struct Node
+        {
+            ICommand * command;
+            size_t dependencies;
+            std::vector<size_t> dependents;
+        };
+
+        struct Run;
+
+        // One SubCommand of one execution
+        struct Task
+        {
+            Run * run;
+            size_t index;
+            std::atomic<size_t> waiting;
+        };
+
+        // The state of one execution; lives on the stack of execute
+        struct Run
+        {
+            Run(ParallelMacroCommand * m, WorkStealingPool * p, const INotification & n)
+                :macro(m), pool(p), notification(n), tasks(m->m_nodes.size()), remaining(m->m_nodes.size())
+            {
+            }
+
+            ParallelMacroCommand * macro;
+            WorkStealingPool * pool;
+            const INotification & notification;
+            std::vector<Task> tasks;
+            std::atomic<size_t> remaining;
+            std::mutex errorMutex;
+            std::exception_ptr error;
+        };
+
+        static void runTask( void * argument )
+        {
+            Task * task = static_cast<Task *>(argument);
+            Run & run = *task->run;
+            while (task != NULL)
+            {
+                const Node & node = run.macro->m_nodes[task->index];
+                try
+                {
+                    node.command->execute(run.notification);
+                }
+                catch (...)
+                {
+                    std::lock_guard<std::mutex> lock(run.errorMutex);
+                    if (!run.error)
+                        run.error = std::current_exception();
+                }
+
+                // continue with one ready dependent, submit the others
+                Task * next = NULL;
+                for (size_t i = 0; i < node.dependents.size(); ++i)
+                {
+                    Task * dependent = &run.tasks[node.dependents[i]];
+                    if (dependent->waiting.fetch_sub(1, std::memory_order_acq_rel) != 1)
+                        continue;
+                    if (next != NULL)
+                        run.pool->submit(&ParallelMacroCommand::runTask, next);
+                    next = dependent;
+                }
+                // last: execute may return, and the Run go away, as soon
+                // as remaining reaches zero
+                run.remaining.fetch_sub(1, std::memory_order_acq_rel);
+                task = next;
+            }
+        }
+
+        ParallelMacroCommand( const ParallelMacroCommand & );
+        ParallelMacroCommand & operator = ( const ParallelMacroCommand & );
+
+        WorkStealingPool * m_pool;
+        std::vector<Node> m_nodes;
+};
+
+#endif //
@@ -124,14 +124,26 @@
 #include "./core/controller.hpp"
 #include "./core/model.hpp"
 #include "./patterns/observer/notification.hpp"
+#include "./patterns/observer/typed_notification.hpp"
+#include "./patterns/observer/async_dispatcher.hpp"
+#include "./patterns/observer/notification_timer.hpp"
+#include "./patterns/observer/shard_bus.hpp"
 #include "./interfaces/ifacade.hpp"
 #include "./utils/singlton.hpp"
+#include "./utils/multiton.hpp"
+#include "./utils/epoch.hpp"
 #include "../patterns/observer/facade_holder.hpp"
+#include <stdexcept>
 
 template<class T>
-class Facade : public IFacade, public Singlton<T >
+class Facade : public IFacade, public Singlton<T >, public Multiton<T >
 {
     public:
+        using Singlton<T>::getInstance; 
+        using Multiton<T>::getInstance; 
+        using Singlton<T>::hasInstance; 
+        using Multiton<T>::hasInstance; 
+
         /**
          * Constructor. 
          * 
@@ -147,9 +159,100 @@ class Facade : public IFacade, public Singlton<T >
         Facade( ) 
 		{
 			m_controller = NULL; 
+			m_dispatcher.store(NULL); 
             //if (m_instance != NULL) throw "Singleton error";
 			FacadeHolder::setFacade(this); 
             initializeFacade();	
+			m_timer = new NotificationTimer(m_view); 
+        }
+
+        /**
+         * Constructor of the Multiton Facade of the core named
+         * <code>key</code>.
+         * 
+         * <P>
+         * <code>T::getInstance(key)</code> constructs it, so a subclass
+         * used as a Multiton declares a constructor taking the key and
+         * passes it on. The Facade then uses
+         * <code>Controller::getInstance(key)</code>,
+         * <code>Model::getInstance(key)</code> and
+         * <code>View::getInstance(key)</code>, so each core has its own
+         * observers, commands, proxies and locks, and cores on different
+         * threads do not contend.</P>
+         * 
+         * <listing>
+         *		class ShardFacade : public Facade<ShardFacade>
+         *		{
+         *		public:
+         *			ShardFacade(const std::string & key) : Facade<ShardFacade>(key) {}
+         *		};
+         *
+         *		ShardFacade::getInstance("shard1")->sendNotification(TICK);
+         * </listing>
+         */
+        explicit Facade( const std::string & key )
+            :m_multitonKey(key)
+		{
+			m_controller = NULL; 
+			m_dispatcher.store(NULL); 
+            initializeFacade();	
+			m_timer = new NotificationTimer(m_view); 
+        }
+
+        virtual ~Facade()
+        {
+            delete m_timer; 
+            stopAsyncDispatch(); 
+        }
+
+        /**
+         * Tear down the Facade and the MVC core.
+         * 
+         * <P>
+         * Stops the timer thread and asynchronous dispatch, then destroys the
+         * <code>Controller</code>, <code>View</code> and <code>Model</code>
+         * Singletons and finally the Facade itself, so that the next
+         * <code>getInstance</code> starts from a fresh core. Mediators,
+         * proxies and commands registered as instances belong to the
+         * caller and are not deleted. No other thread may use the core
+         * meanwhile.</P>
+         */
+        static void destroyInstance()
+        {
+            if (Singlton<T>::hasInstance())
+            {
+                Singlton<T>::getInstance()->stopTimers(); 
+                Singlton<T>::getInstance()->stopAsyncDispatch(); 
+            }
+            Controller::destroyInstance(); 
+            View::destroyInstance(); 
+            Model::destroyInstance(); 
+            Singlton<T>::destroyInstance(); 
+        }
+
+        /**
+         * Tear down the Multiton Facade and core named <code>key</code>,
+         * like <code>destroyInstance()</code> does for the Singleton.
+         */
+        static void destroyInstance(const std::string & key)
+        {
+            if (Multiton<T>::hasInstance(key))
+            {
+                Multiton<T>::getInstance(key)->stopTimers(); 
+                Multiton<T>::getInstance(key)->stopAsyncDispatch(); 
+            }
+            Controller::destroyInstance(key); 
+            View::destroyInstance(key); 
+            Model::destroyInstance(key); 
+            Multiton<T>::destroyInstance(key); 
+        }
+
+        /**
+         * The key of this Facade's core; empty for the Singleton.
+         */
+        const std::string & getMultitonKey() const
+        {
+            return m_multitonKey; 
         }
 
         /**
@@ -198,7 +301,10 @@ class Facade : public IFacade, public Singlton<T >
 		{
             if ( m_controller != NULL ) 
 				return;
-			m_controller = Controller::getInstance();
+            if (m_multitonKey.empty())
+                m_controller = Controller::getInstance();
+            else
+                m_controller = Controller::getInstance(m_multitonKey);
         }
 
         /**
@@ -227,7 +333,10 @@ class Facade : public IFacade, public Singlton<T >
         void initializeModel( )
 		{
             //if ( m_model != NULL ) return;
-			m_model = Model::getInstance();
+            if (m_multitonKey.empty())
+                m_model = Model::getInstance();
+            else
+                m_model = Model::getInstance(m_multitonKey);
         }
 
 
@@ -256,7 +365,10 @@ class Facade : public IFacade, public Singlton<T >
         void initializeView( )
         {
             //if ( m_view != NULL ) return;
-			m_view = View::getInstance();
+            if (m_multitonKey.empty())
+                m_view = View::getInstance();
+            else
+                m_view = View::getInstance(m_multitonKey);
         }
 
         /**
@@ -270,6 +382,58 @@ class Facade : public IFacade, public Singlton<T >
             m_controller->registerCommand( notificationName, command );
         }
 
+        /**
+         * Register a command class with the <code>Controller</code> by Notification name.
+         * 
+         * <P>
+         * A new <code>C</code> handles each notification; see
+         * <code>CommandFactory</code>, which the <code>Controller</code>
+         * owns.</P>
+         * 
+         * @param notificationName the name of the <code>INotification</code> to associate the command class with
+         * @throws std::logic_error if the Facade's <code>IController</code> is not a <code>Controller</code>
+         */
+		template <class C>
+		void registerCommand( const std::string & notificationName) 
+        {
+            getController()->template registerCommand<C>( notificationName );
+        }
+
+        /**
+         * Register an <code>ICommand</code> the <code>Controller</code>
+         * runs on its command executor instead of the sending thread.
+         * 
+         * @param notificationName the name of the <code>INotification</code> to associate the <code>ICommand</code> with
+         * @param command the <code>ICommand</code> to run
+         */
+		void registerAsyncCommand( const std::string & notificationName, ICommand * command) 
+        {
+            m_controller->registerAsyncCommand( notificationName, command );
+        }
+
+        /**
+         * Register a command class whose instances the <code>Controller</code>
+         * creates and runs on its command executor, one per notification.
+         * 
+         * @param notificationName the name of the <code>INotification</code> to associate the command class with
+         * @throws std::logic_error if the Facade's <code>IController</code> is not a <code>Controller</code>
+         */
+		template <class C>
+		void registerAsyncCommand( const std::string & notificationName) 
+        {
+            getController()->template registerAsyncCommand<C>( notificationName );
+        }
+
+        /**
+         * Wait until every async command queued so far has run.
+         * 
+         * @throws the first exception an async command threw since the last flush
+         */
+		void flushCommands() 
+        {
+            m_controller->flushCommands();
+        }
+
         /**
          * Remove a previously registered <code>ICommand</code> to <code>INotification</code> mapping from the Controller.
          * 
@@ -313,6 +477,39 @@ class Facade : public IFacade, public Singlton<T >
             return m_model->retrieveProxy ( proxyName );	
         }
 
+        /**
+         * Get the handle of a proxy name for fast lookups with
+         * <code>retrieveProxy(handle)</code>.
+         *
+         * @param proxyName the name of the <code>IProxy</code>.
+         * @return a handle valid for the life of the <code>Model</code>.
+         */
+        ProxyHandle getProxyHandle ( const std::string & proxyName)
+        {
+            return m_model->getProxyHandle ( proxyName );	
+        }
+
+        /**
+         * Retrieve an <code>IProxy</code> from the <code>Model</code> by handle.
+         *
+         * @param handle a handle returned by <code>getProxyHandle</code>.
+         * @return the <code>IProxy</code> currently registered under the handle's name, or NULL.
+         */
+        IProxy * retrieveProxy ( const ProxyHandle & handle)
+        {
+            return m_model->retrieveProxy ( handle );	
+        }
+
+        /**
+         * Retrieve a proxy by handle as the class it was registered as;
+         * <code>P</code> is not checked.
+         */
+        template <class P>
+        P * retrieveProxy ( const ProxyHandle & handle)
+        {
+            return static_cast<P *>(m_model->retrieveProxy ( handle ));	
+        }
+
         /**
          * Remove an <code>IProxy</code> from the <code>Model</code> by name.
          *
@@ -401,11 +598,262 @@ class Facade : public IFacade, public Singlton<T >
             notifyObservers( noti );
         }
 
+		/**
+		 * Send a batch of notifications at once.
+		 * 
+		 * <P>
+		 * The observers of each name are looked up once for the whole
+		 * batch and a mediator gets all notifications with a name it is
+		 * interested in through one <code>handleNotifications</code>
+		 * call. Order is kept among notifications with the same name
+		 * only.</P>
+		 * 
+		 * @param batch the notifications to send
+		 */
+		void sendNotifications(const NotificationBatch & batch)
+		{
+			notifyObservers(batch); 
+		}
+
 		virtual void sendNotification(const std::string & name)
 		{
 			Notification noti(name); 
 			notifyObservers(noti); 
 		}
+
+		/**
+		 * Create and send an <code>INotification</code> by interned name.
+		 * 
+		 * <P>
+		 * Skips the name lookup entirely; get the id once from
+		 * <code>NotificationIds::registerType</code>.</P>
+		 */
+		virtual void sendNotification(NotificationId id, void * body = NULL, const std::string & type = "")
+		{
+			Notification noti(id, body, type); 
+			notifyObservers(noti); 
+		}
+
+		/**
+		 * Create and send an <code>INotification</code> named by a
+		 * compile-time <code>NotificationKey</code>.
+		 * 
+		 * <P>
+		 * The id is found from the precomputed hash; the name is only
+		 * copied when nothing was ever registered for it.</P>
+		 */
+		virtual void sendNotification(const NotificationKey & key, void * body = NULL, const std::string & type = "")
+		{
+			NotificationId id = NotificationIds::getInstance()->getTypeIndex(key);
+			if (id == 0)
+			{
+				Notification noti(std::string(key), body, type); 
+				notifyObservers(noti); 
+				return;
+			}
+			Notification noti(id, body, type); 
+			notifyObservers(noti); 
+		}
+		/**
+		 * Create and send a <code>TypedNotification</code>.
+		 * 
+		 * <P>
+		 * The body lives on the stack for the duration of the send and
+		 * handlers read it with <code>notification_cast&lt;B&gt;</code>.</P>
+		 */
+		template <class B>
+		void sendTypedNotification(NotificationId id, B body, const std::string & type = "")
+		{
+			TypedNotification<B> noti(id, std::move(body), type); 
+			notifyObservers(noti); 
+		}
+
+		template <class B>
+		void sendTypedNotification(const std::string & name, B body, const std::string & type = "")
+		{
+			TypedNotification<B> noti(name, std::move(body), type); 
+			notifyObservers(noti); 
+		}
+
+		/**
+		 * Start delivering posted notifications on worker threads.
+		 * 
+		 * <P>
+		 * Notifications with the same name are delivered in the order
+		 * they were posted, by one worker at a time. Calling this again
+		 * drains the current workers before starting new ones.</P>
+		 * 
+		 * <P>
+		 * Threads may keep posting meanwhile, as with
+		 * <code>stopAsyncDispatch</code>.</P>
+		 * 
+		 * @param threads number of worker threads
+		 * @param capacity bound of each worker's queue
+		 * @param policy what <code>postNotification</code> does when a queue is full
+		 */
+		void startAsyncDispatch(size_t threads = 1, size_t capacity = 1024, 
+				AsyncDispatcher::OverflowPolicy policy = AsyncDispatcher::BLOCK)
+		{
+			std::lock_guard<std::mutex> lock(m_dispatchMutex); 
+			retireDispatcher(); 
+			m_dispatcher.store(new AsyncDispatcher(m_view, threads, capacity, policy)); 
+		}
+
+		/**
+		 * Start delivering posted notifications on the tasks of a
+		 * <code>WorkStealingPool</code>, such as the shared
+		 * <code>WorkStealingPool::getInstance()</code>, instead of
+		 * dedicated threads. Ordering is as for the threaded dispatch.
+		 * 
+		 * @param pool the pool to deliver on
+		 * @param shards number of queues, 0 for one per pool worker
+		 * @param capacity bound of each queue
+		 * @param policy what <code>postNotification</code> does when a queue is full
+		 */
+		void startAsyncDispatch(WorkStealingPool & pool, size_t shards = 0, size_t capacity = 1024, 
+				AsyncDispatcher::OverflowPolicy policy = AsyncDispatcher::BLOCK)
+		{
+			std::lock_guard<std::mutex> lock(m_dispatchMutex); 
+			retireDispatcher(); 
+			m_dispatcher.store(new AsyncDispatcher(m_view, pool, shards, capacity, policy)); 
+		}
+
+		/**
+		 * Deliver everything already posted, then stop the workers.
+		 * 
+		 * <P>
+		 * Other threads may still be posting: posts that race with the
+		 * stop are either delivered by the stopping workers or sent
+		 * synchronously. Must not be called from a notification
+		 * handler.</P>
+		 */
+		void stopAsyncDispatch()
+		{
+			std::lock_guard<std::mutex> lock(m_dispatchMutex); 
+			retireDispatcher(); 
+		}
+
+		/**
+		 * Wait until everything posted so far has been delivered.
+		 * 
+		 * <P>
+		 * What an observer threw meanwhile and no flush has reported yet
+		 * is dropped when the dispatch stops.</P>
+		 * 
+		 * @throws the first exception an observer threw on the async workers since the last flush
+		 */
+		void flushNotifications()
+		{
+			EpochDomain::Guard guard(m_dispatchEpoch); 
+			AsyncDispatcher * dispatcher = m_dispatcher.load(std::memory_order_acquire); 
+			if (dispatcher != NULL)
+			{
+				dispatcher->flush(); 
+				dispatcher->rethrow(); 
+			}
+		}
+
+		/**
+		 * Create an <code>INotification</code> and queue it for delivery
+		 * on the async workers.
+		 * 
+		 * <P>
+		 * Without <code>startAsyncDispatch</code> the notification is sent
+		 * synchronously instead.</P>
+		 * 
+		 * @return false if the notification was dropped because its queue was full.
+		 */
+		bool postNotification(const std::string & name, void * body = NULL, const std::string & type = "")
+		{
+			return queueNotification(Notification(name, body, type)); 
+		}
+
+		bool postNotification(NotificationId id, void * body = NULL, const std::string & type = "")
+		{
+			return queueNotification(Notification(id, body, type)); 
+		}
+
+		/**
+		 * Send a notification once <code>delay</code> has passed.
+		 * 
+		 * <P>
+		 * The notification is delivered by whichever thread calls
+		 * <code>tickTimers</code>, or by the timer thread started with
+		 * <code>startTimers</code>, through the <code>View</code> like any
+		 * other. Delays are rounded up to the timer resolution of 1 ms.</P>
+		 * 
+		 * @return the handle to pass to <code>cancelNotification</code>
+		 */
+		TimerId sendNotificationAfter(const std::string & name, NotificationTimer::Clock::duration delay, 
+				void * body = NULL, const std::string & type = "")
+		{
+			return m_timer->schedule(Notification(name, body, type), delay); 
+		}
+
+		TimerId sendNotificationAfter(NotificationId id, NotificationTimer::Clock::duration delay, 
+				void * body = NULL, const std::string & type = "")
+		{
+			return m_timer->schedule(Notification(id, body, type), delay); 
+		}
+
+		/**
+		 * Send a notification every <code>period</code>, starting one
+		 * period from now, until it is cancelled.
+		 * 
+		 * @return the handle to pass to <code>cancelNotification</code>
+		 */
+		TimerId sendNotificationEvery(const std::string & name, NotificationTimer::Clock::duration period, 
+				void * body = NULL, const std::string & type = "")
+		{
+			return m_timer->schedule(Notification(name, body, type), period, period); 
+		}
+
+		TimerId sendNotificationEvery(NotificationId id, NotificationTimer::Clock::duration period, 
+				void * body = NULL, const std::string & type = "")
+		{
+			return m_timer->schedule(Notification(id, body, type), period, period); 
+		}
+
+		/**
+		 * Cancel a delayed or periodic notification.
+		 * 
+		 * @return false if it was already sent or cancelled.
+		 */
+		bool cancelNotification(const TimerId & timer)
+		{
+			return m_timer->cancel(timer); 
+		}
+
+		/**
+		 * Send every delayed and periodic notification due by <code>now</code>.
+		 * 
+		 * <P>
+		 * For applications that drive time themselves rather than
+		 * running the timer thread.</P>
+		 * 
+		 * @return the number of notifications sent
+		 */
+		size_t tickTimers(NotificationTimer::Clock::time_point now = NotificationTimer::Clock::now())
+		{
+			return m_timer->tick(now); 
+		}
+
+		/**
+		 * Start the thread sending delayed and periodic notifications.
+		 */
+		void startTimers()
+		{
+			m_timer->start(); 
+		}
+
+		/**
+		 * Stop the timer thread; pending timers are kept.
+		 */
+		void stopTimers()
+		{
+			m_timer->stop(); 
+		}
+
 		virtual void sendNotificationTo(const std::string & name ,ObserverMediators & observers) 
 		{
 			Notification noti(name); 
@@ -428,10 +876,21 @@ class Facade : public IFacade, public Singlton<T >
          * and pass the parameters, never having to 
          * construct the notification yourself.</P>
          * 
+         * <P>
+         * Called on the thread of the <code>ShardBus</code> shard that
+         * owns this core, the notification is routed through the bus
+         * and also reaches the other shards that observe it.</P>
+         * 
          * @param notification the <code>INotification</code> to have the <code>View</code> notify <code>Observers</code> of.
          */
         void notifyObservers ( const INotification & notification) 
         {
+            ShardBus * bus = ShardBus::current(); 
+            if (bus != NULL && m_view != NULL && bus->getView(ShardBus::currentShard()) == m_view)
+            {
+                bus->sendNotification( notification ); 
+                return; 
+            }
             if ( m_view != NULL ) 
 			{
                 m_view->notifyObservers( notification );
@@ -447,12 +906,120 @@ class Facade : public IFacade, public Singlton<T >
 			}
 		}
 
+		void notifyObservers(const NotificationBatch & batch)
+		{
+			if (m_view != NULL)
+			{
+				m_view->notifyObservers(batch);
+			}
+		}
+
+		/**
+		 * Coalesce notifications with a given name in the <code>View</code>.
+		 * 
+		 * <P>
+		 * A burst of such notifications, sent with <code>sendNotification</code>,
+		 * reaches the observers once, merged by <code>merge</code>, when
+		 * <code>flushCoalesced</code> is called or the coalescing window
+		 * has passed; see <code>IView::coalesceNotifications</code>.</P>
+		 * 
+		 * @param notificationName the name of the notifications to coalesce
+		 * @param merge folds an incoming notification into the pending one; by default the latest body and type win
+		 * @param byType whether notifications with different types are kept apart
+		 */
+		void coalesceNotifications(const std::string & notificationName, CoalesceMerge merge = NULL, bool byType = false)
+		{
+			m_view->coalesceNotifications(NotificationIds::getInstance()->registerType(notificationName), merge, byType);
+		}
+
+		/**
+		 * Stop coalescing a name; what is pending for it is delivered.
+		 */
+		void stopCoalescing(const std::string & notificationName)
+		{
+			m_view->stopCoalescing(NotificationIds::getInstance()->registerType(notificationName));
+		}
+
+		/**
+		 * How long a coalesced notification may stay pending; zero holds it until <code>flushCoalesced</code>.
+		 * 
+		 * <P>
+		 * A window starts the timer thread, whose ticks deliver what
+		 * is pending once the window has passed; see
+		 * <code>IView::flushExpiredCoalesced</code>.</P>
+		 */
+		void setCoalescingWindow(std::chrono::microseconds window)
+		{
+			m_view->setCoalescingWindow(window);
+			if (window.count() > 0)
+				m_timer->start(); 
+		}
+
+		/**
+		 * Deliver every pending coalesced notification.
+		 * 
+		 * @return the number of notifications delivered
+		 */
+		size_t flushCoalesced()
+		{
+			return m_view->flushCoalesced();
+		}
+
     protected:
+		bool queueNotification(const Notification & noti)
+		{
+			{
+				// keeps the dispatcher alive until post returns
+				EpochDomain::Guard guard(m_dispatchEpoch); 
+				AsyncDispatcher * dispatcher = m_dispatcher.load(std::memory_order_acquire); 
+				if (dispatcher != NULL)
+					return dispatcher->post(noti); 
+			}
+			notifyObservers(noti); 
+			return true; 
+		}
+
+		// The Controller that creates and owns the factories of
+		// registerCommand<C> and registerAsyncCommand<C>
+		Controller * getController()
+		{
+			Controller * controller = dynamic_cast<Controller *>(m_controller); 
+			if (controller == NULL)
+				throw std::logic_error("registerCommand<C> needs the Facade's controller to be a Controller"); 
+			return controller; 
+		}
+
+		// Unpublish the dispatcher, wait for posts still using it to
+		// return, then drain and delete it. m_dispatchMutex is held.
+		void retireDispatcher()
+		{
+			AsyncDispatcher * old = m_dispatcher.exchange(NULL); 
+			if (old == NULL)
+				return; 
+			m_dispatchEpoch.synchronize(); 
+			delete old; 
+		}
+
         // Private references to Model, View and Controller
         IController * m_controller ;
         IModel *m_model;
         IView *m_view;
 
+        // Workers delivering posted notifications, if started
+        std::atomic<AsyncDispatcher *> m_dispatcher; 
+
+        // Posts in flight pin m_dispatcher in this domain
+        EpochDomain m_dispatchEpoch; 
+
+        // Serialises startAsyncDispatch and stopAsyncDispatch
+        std::mutex m_dispatchMutex; 
+
+        // Delayed and periodic notifications
+        NotificationTimer * m_timer; 
+
+        // Key of the core, empty for the Singleton
+        std::string m_multitonKey; 
+
         // The Singleton Facade instance.
         //static IFacade * m_instance ; 
 
@@ -0,0 +1,248 @@
+#ifndef __ASYNC_DISPATCHER_HPP__
+#define __ASYNC_DISPATCHER_HPP__
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <vector>
+#include <thread>
+#include "../../interfaces/iview.hpp"
+#include "../../utils/bounded_queue.hpp"
+#include "../../utils/work_stealing_pool.hpp"
+#include "notification.hpp"
+
+/**
+ * Delivers posted <code>Notification</code>s on a pool of worker threads.
+ *
+ * <P>
+ * Every worker owns a queue, and a notification is always queued to
+ * the worker selected by its <code>NotificationId</code>. Notifications
+ * with the same name are therefore delivered one at a time and in the
+ * order they were posted, while different names proceed in parallel.</P>
+ *
+ * <P>
+ * Delivery goes through <code>IView::notifyObservers</code>, exactly
+ * as a synchronous <code>sendNotification</code> would. An exception
+ * thrown by an observer is caught on the worker, which goes on with
+ * the next notification; the first one is kept for
+ * <code>rethrow</code>.</P>
+ *
+ * <P>
+ * Given a <code>WorkStealingPool</code> instead of a thread count, the
+ * dispatcher starts no threads. Each queue then becomes a strand: the
+ * first notification posted to an idle queue submits a task that
+ * drains it on the pool, and at most one such task per queue is queued
+ * or running, so the ordering above still holds. With the
+ * <code>BLOCK</code> policy, posting from a task on the same pool can
+ * wait on a queue only that pool drains; use <code>GROW</code> or
+ * <code>DROP</code> there.</P>
+ */
+class AsyncDispatcher
+{
+    public:
+        typedef BoundedQueue<Notification> NotificationQueue;
+        typedef NotificationQueue::OverflowPolicy OverflowPolicy;
+
+        static const OverflowPolicy BLOCK = NotificationQueue::BLOCK;
+        static const OverflowPolicy DROP = NotificationQueue::DROP;
+        static const OverflowPolicy GROW = NotificationQueue::GROW;
+
+        /**
+         * Start the workers.
+         *
+         * @param view the <code>IView</code> to deliver notifications to
+         * @param threads number of worker threads
+         * @param capacity bound of each worker's queue
+         * @param policy what <code>post</code> does when a queue is full
+         */
+        AsyncDispatcher(IView * view, size_t threads, size_t capacity, OverflowPolicy policy)
+            :m_view(view), m_pool(NULL), m_draining(0)
+        {
+            if (threads == 0)
+                threads = 1;
+            for (size_t i = 0; i < threads; ++i)
+            {
+                m_queues.push_back(new NotificationQueue(capacity, policy));
+            }
+            for (size_t i = 0; i < threads; ++i)
+            {
+                m_workers.push_back(std::thread(&AsyncDispatcher::run, this, m_queues[i]));
+            }
+        }
+
+        /**
+         * Deliver on the tasks of a pool instead of dedicated threads.
+         *
+         * @param view the <code>IView</code> to deliver notifications to
+         * @param pool the pool to drain the queues on
+         * @param shards number of queues, 0 for one per pool worker
+         * @param capacity bound of each queue
+         * @param policy what <code>post</code> does when a queue is full
+         */
+        AsyncDispatcher(IView * view, WorkStealingPool & pool, size_t shards, size_t capacity, OverflowPolicy policy)
+            :m_view(view), m_pool(&pool), m_draining(0)
+        {
+            if (shards == 0)
+                shards = pool.size();
+            for (size_t i = 0; i < shards; ++i)
+            {
+                m_queues.push_back(new NotificationQueue(capacity, policy));
+                m_strands.push_back(new Strand(this, m_queues[i]));
+            }
+        }
+
+        /**
+         * Drain every queue and join the workers.
+         */
+        ~AsyncDispatcher()
+        {
+            if (m_pool != NULL)
+            {
+                flush();
+                m_pool->waitFor(m_draining);
+            }
+            for (size_t i = 0; i < m_queues.size(); ++i)
+            {
+                m_queues[i]->close();
+            }
+            for (size_t i = 0; i < m_workers.size(); ++i)
+            {
+                m_workers[i].join();
+            }
+            for (size_t i = 0; i < m_strands.size(); ++i)
+            {
+                delete m_strands[i];
+            }
+            for (size_t i = 0; i < m_queues.size(); ++i)
+            {
+                delete m_queues[i];
+            }
+        }
+
+        /**
+         * Queue a notification for delivery.
+         *
+         * @return false if the notification was dropped.
+         */
+        bool post(const Notification & notification)
+        {
+            size_t shard = (size_t)NotificationIds::resolve(notification) % m_queues.size();
+            if (!m_queues[shard]->push(notification))
+                return false;
+            if (m_pool != NULL)
+                schedule(m_strands[shard]);
+            return true;
+        }
+
+        /**
+         * Wait until everything posted so far has been delivered.
+         */
+        void flush()
+        {
+            for (size_t i = 0; i < m_queues.size(); ++i)
+            {
+                m_queues[i]->flush();
+            }
+        }
+
+        /**
+         * Rethrow the first exception an observer threw since the last call, if any.
+         */
+        void rethrow()
+        {
+            std::exception_ptr caught;
+            {
+                std::lock_guard<std::mutex> lock(m_errorMutex);
+                caught.swap(m_error);
+            }
+            if (caught)
+                std::rethrow_exception(caught);
+        }
+
+    private:
+        // A queue drained by at most one pool task at a time
+        struct Strand
+        {
+            Strand(AsyncDispatcher * d, NotificationQueue * q)
+                :dispatcher(d), queue(q), scheduled(false)
+            {
+            }
+
+            AsyncDispatcher * dispatcher;
+            NotificationQueue * queue;
+            std::atomic<bool> scheduled;
+        };
+
+        // notifications a drain task delivers before giving way to other tasks
+        enum { DRAIN_BATCH = 64 };
+
+        void schedule(Strand * strand)
+        {
+            if (!strand->scheduled.exchange(true))
+            {
+                m_draining.fetch_add(1);
+                m_pool->submit(&AsyncDispatcher::drain, strand);
+            }
+        }
+
+        static void drain(void * argument)
+        {
+            Strand * strand = static_cast<Strand *>(argument);
+            AsyncDispatcher * dispatcher = strand->dispatcher;
+            Notification notification(NotificationId(0));
+            for (int i = 0; i < DRAIN_BATCH && strand->queue->tryPop(notification); ++i)
+            {
+                dispatcher->deliver(notification);
+                strand->queue->done();
+            }
+            // a post that saw the strand scheduled after our last tryPop
+            // is picked up by this check
+            strand->scheduled.store(false);
+            if (strand->queue->size() != 0)
+                dispatcher->schedule(strand);
+            // last: the destructor may free the strand once this is zero
+            dispatcher->m_draining.fetch_sub(1, std::memory_order_release);
+        }
+
+        void run(NotificationQueue * queue)
+        {
+            Notification notification(NotificationId(0));
+            while (queue->pop(notification))
+            {
+                deliver(notification);
+                queue->done();
+            }
+        }
+
+        // Pool tasks and workers must not throw: keep what an observer
+        // threw, so that done() is reached and a flush cannot hang
+        void deliver(const Notification & notification)
+        {
+            try
+            {
+                m_view->notifyObservers(notification);
+            }
+            catch (...)
+            {
+                std::lock_guard<std::mutex> lock(m_errorMutex);
+                if (!m_error)
+                    m_error = std::current_exception();
+            }
+        }
+
+        AsyncDispatcher(const AsyncDispatcher &);
+        AsyncDispatcher & operator = (const AsyncDispatcher &);
+
+        IView * m_view;
+        // the pool draining the queues, or NULL for dedicated workers
+        WorkStealingPool * m_pool;
+        std::vector<NotificationQueue *> m_queues;
+        std::vector<Strand *> m_strands;
+        // drain tasks submitted and not yet finished
+        std::atomic<size_t> m_draining;
+        std::vector<std::thread> m_workers;
+        // guards m_error, the first exception an observer threw
+        std::mutex m_errorMutex;
+        std::exception_ptr m_error;
+};
+
+#endif //
@@ -1,6 +1,7 @@
 #ifndef __NOTIFICATION_HPP__
 #define __NOTIFICATION_HPP__
 #include "../../interfaces/inotification.hpp"
+#include "notification_ids.hpp"
 
 #include <string> 
 
@@ -18,18 +19,32 @@ class Notification : public INotification
          * @param type the type of the <code>Notification</code> (optional)
          */
 		Notification(const char * name)
+			:m_name(name)
 		{
-			this->m_name = name; 
+			this->m_body = NULL; 
 		}
 
 		Notification(const std::string & name)
+			:m_name(name)
 		{
-			this->m_name = name; 
+			this->m_body = NULL; 
 		}
 
         Notification( const std::string & name, void* body, const std::string & type="")
+			:m_name(name)
+        {
+            this->m_type = type;
+            this->m_body = body;
+        }
+
+        /**
+         * Constructor from an interned name.
+         * 
+         * @param id the id returned by <code>NotificationIds::registerType</code>.
+         */
+        Notification( NotificationId id, void* body = NULL, const std::string & type="")
+			:m_name(id)
         {
-            this->m_name = name;
             this->m_type = type;
             this->m_body = body;
         }
@@ -39,9 +54,27 @@ class Notification : public INotification
          * 
          * @return the name of the <code>Notification</code> instance.
          */
-        std::string getName() const 
+        const std::string & getName() const 
+        {
+            return m_name.str();
+        }
+
+        /**
+         * Get the interned id of the <code>Notification</code> name.
+         * 
+         * @return the id, or 0 if the name was not interned at construction.
+         */
+        NotificationId getId() const 
+        {
+            return m_name.id();
+        }
+
+        /**
+         * Get the hash of the name, computed once at construction.
+         */
+        size_t getNameHash() const 
         {
-            return m_name;
+            return m_name.hash();
         }
 
         /**
@@ -75,7 +108,7 @@ class Notification : public INotification
          * 
          * @return the type  
          */
-        std::string getType()
+        const std::string & getType() const
         {
             return m_type;
         }
@@ -93,8 +126,8 @@ class Notification : public INotification
             return msg;
         }
     private:
-        // the name of the notification instance
-        std::string m_name;
+        // the name of the notification instance, with its id and hash
+        NotificationName m_name;
         // the type of the notification instance
         std::string m_type;
         // the body of the notification instance
@@ -0,0 +1,329 @@
+#ifndef __NOTIFICATION_IDS_HPP__
+#define __NOTIFICATION_IDS_HPP__
+#include <string>
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <stdexcept>
+#include "../../interfaces/inotification.hpp"
+#include "../../utils/typetoindex.hpp"
+#include "../../utils/singlton.hpp"
+#include "../../utils/epoch.hpp"
+#include "notification_key.hpp"
+
+/**
+ * A Singleton table interning <code>INotification</code> names.
+ *
+ * <P>
+ * Every name an <code>IObserver</code> or <code>ICommand</code> is
+ * registered for gets a dense <code>NotificationId</code>, so that
+ * the <code>View</code> and <code>Controller</code> can keep their
+ * registries in flat arrays indexed by id instead of hashing the
+ * name on every notification.</P>
+ *
+ * <P>
+ * The table is keyed by <code>NameKey</code>, so a notification that
+ * hashed its name once at construction can be looked up again without
+ * rehashing.</P>
+ *
+ * <P>
+ * No two interned names may share a hash: <code>registerType</code>
+ * throws <code>std::logic_error</code> on a collision. An id can then
+ * be found from the hash and confirmed with a single name comparison,
+ * which is how compile-time <code>NotificationKey</code>s are
+ * resolved.</P>
+ *
+ * <P>
+ * Lookups are lock-free and may run on any thread; interning a new
+ * name copies the table under a mutex and publishes the copy.</P>
+ *
+ * <P>
+ * Interned names are never freed or moved, so <code>getName</code>
+ * can hand out references that notifications keep instead of copying
+ * the string. The table is therefore immortal: unlike the other
+ * Singletons it has no <code>destroyInstance</code>, and it lives
+ * until the process exits.</P>
+ */
+class NotificationIds : public Singlton<NotificationIds>
+{
+    public:
+        typedef TypeToIndex<NameKey> NameIndex;
+        // interned names by id; the strings are owned by NotificationIds
+        typedef std::vector<NameKey> NameArray;
+        typedef hash_map<size_t, NotificationId> HashIndex;
+
+        struct NameTable
+        {
+            NameIndex index;
+            NameArray names;
+            HashIndex byHash;
+        };
+
+        NotificationIds()
+            :m_table(new NameTable())
+        {
+            NameTable * table = const_cast<NameTable *>(m_table.load());
+            table->names.push_back(NameKey(hashString(m_empty), &m_empty));
+        }
+
+        /**
+         * Get the id of a name, or 0 if it was never registered.
+         */
+        NotificationId getTypeIndex(const std::string & name) const
+        {
+            return getTypeIndex(name, hashString(name));
+        }
+
+        /**
+         * Get the id of a name whose <code>hashString</code> is already known.
+         */
+        NotificationId getTypeIndex(const std::string & name, size_t hash) const
+        {
+            EpochDomain::Guard guard(m_epoch);
+            return m_table.load(std::memory_order_acquire)->index.getTypeIndex(NameKey(hash, &name));
+        }
+
+        /**
+         * Get the id of a compile-time key, or 0 if it was never registered.
+         *
+         * <P>
+         * An unregistered key whose hash collides with a registered name
+         * gets 0, not that name's id.</P>
+         */
+        NotificationId getTypeIndex(const NotificationKey & key) const
+        {
+            EpochDomain::Guard guard(m_epoch);
+            const NameTable * table = m_table.load(std::memory_order_acquire);
+            HashIndex::const_iterator itr = table->byHash.find(key.hash());
+            if (itr != table->byHash.end() && key.isNamed(*table->names[itr->second].name))
+            {
+                return itr->second;
+            }
+            return 0;
+        }
+
+        /**
+         * Get the id of a compile-time key, interning its name if
+         * necessary.
+         *
+         * @throws std::logic_error if another name with the same hash is registered
+         */
+        NotificationId registerType(const NotificationKey & key)
+        {
+            NotificationId id = getTypeIndex(key);
+            if (id != 0)
+                return id;
+            // rejects a key that collides with a registered name
+            return registerType(std::string(key));
+        }
+
+        /**
+         * Get the id of a name, interning it if necessary.
+         *
+         * @throws std::logic_error if another name with the same hash is registered
+         */
+        NotificationId registerType(const std::string & name)
+        {
+            size_t hash = hashString(name);
+            NotificationId id = getTypeIndex(name, hash);
+            if (id != 0)
+                return id;
+
+            std::lock_guard<std::mutex> lock(m_mutex);
+            const NameTable * current = m_table.load();
+            id = current->index.getTypeIndex(NameKey(hash, &name));
+            if (id != 0)
+                return id;
+
+            HashIndex::const_iterator collision = current->byHash.find(hash);
+            if (collision != current->byHash.end())
+            {
+                throw std::logic_error("notification name hash collision: \"" + name +
+                        "\" and \"" + *current->names[collision->second].name + "\"");
+            }
+
+            // the key stored in the index must point at the interned copy
+            NameKey key(hash, new std::string(name));
+            NameTable * table = new NameTable(*current);
+            id = table->index.registerType(key);
+            table->names.push_back(key);
+            table->byHash[hash] = id;
+            m_table.store(table, std::memory_order_release);
+            m_epoch.retire(current);
+            return id;
+        }
+
+        /**
+         * Get the name interned as <code>id</code>, or an empty string.
+         */
+        std::string getIndexType(NotificationId id) const
+        {
+            return getName(id);
+        }
+
+        /**
+         * Get the name interned as <code>id</code>, or an empty string.
+         *
+         * <P>
+         * The reference stays valid for the lifetime of the table.</P>
+         */
+        const std::string & getName(NotificationId id) const
+        {
+            EpochDomain::Guard guard(m_epoch);
+            const NameArray & names = m_table.load(std::memory_order_acquire)->names;
+            if (id > 0 && (size_t)id < names.size())
+            {
+                return *names[id].name;
+            }
+            return m_empty;
+        }
+
+        /**
+         * Get the <code>hashString</code> of the name interned as <code>id</code>.
+         */
+        size_t getNameHash(NotificationId id) const
+        {
+            EpochDomain::Guard guard(m_epoch);
+            const NameArray & names = m_table.load(std::memory_order_acquire)->names;
+            if (id > 0 && (size_t)id < names.size())
+            {
+                return names[id].hash;
+            }
+            return names[0].hash;
+        }
+
+        /**
+         * Number of slots, including the reserved id 0.
+         */
+        size_t size() const
+        {
+            EpochDomain::Guard guard(m_epoch);
+            return m_table.load(std::memory_order_acquire)->names.size();
+        }
+
+        /**
+         * Resolve the id of a notification.
+         *
+         * <P>
+         * Uses the id carried by the notification when there is one,
+         * otherwise falls back to looking up its name, reusing the hash
+         * the notification computed at construction.</P>
+         *
+         * @return the id, or 0 if nothing was ever registered for the name.
+         */
+        static NotificationId resolve(const INotification & notification)
+        {
+            NotificationId id = notification.getId();
+            if (id == 0)
+            {
+                const std::string & name = notification.getName();
+                size_t hash = notification.getNameHash();
+                id = getInstance()->getTypeIndex(name, hash != 0 ? hash : hashString(name));
+            }
+            return id;
+        }
+
+    private:
+        // Not defined: every NotificationName and Notification refers
+        // to the interned names, so the table is never destroyed
+        static void destroyInstance();
+        ~NotificationIds();
+
+        std::string m_empty;
+        std::atomic<const NameTable *> m_table;
+        EpochDomain m_epoch;
+        std::mutex m_mutex;
+};
+
+/**
+ * The name of a notification, with its id and hash.
+ *
+ * <P>
+ * The name is hashed and looked up exactly once, at construction. It
+ * refers to the copy interned in <code>NotificationIds</code> when the
+ * name is known there, and only owns a copy of its own otherwise, so
+ * building a notification for a registered name never allocates.</P>
+ */
+class NotificationName
+{
+    public:
+        explicit NotificationName(NotificationId id)
+            :m_id(id),
+             m_name(&NotificationIds::getInstance()->getName(id)),
+             m_hash(NotificationIds::getInstance()->getNameHash(id))
+        {
+        }
+
+        explicit NotificationName(const std::string & name)
+            :m_hash(hashString(name))
+        {
+            m_id = NotificationIds::getInstance()->getTypeIndex(name, m_hash);
+            if (m_id != 0)
+            {
+                m_name = &NotificationIds::getInstance()->getName(m_id);
+            }
+            else
+            {
+                m_owned = name;
+                m_name = &m_owned;
+            }
+        }
+
+        NotificationName(const NotificationName & other)
+            :m_id(other.m_id), m_owned(other.m_owned), m_hash(other.m_hash)
+        {
+            m_name = other.owns() ? &m_owned : other.m_name;
+        }
+
+        NotificationName & operator = (const NotificationName & other)
+        {
+            if (this != &other)
+            {
+                m_id = other.m_id;
+                m_owned = other.m_owned;
+                m_name = other.owns() ? &m_owned : other.m_name;
+                m_hash = other.m_hash;
+            }
+            return *this;
+        }
+
+        const std::string & str() const
+        {
+            return *m_name;
+        }
+
+        NotificationId id() const
+        {
+            return m_id;
+        }
+
+        size_t hash() const
+        {
+            return m_hash;
+        }
+
+    private:
+        bool owns() const
+        {
+            return m_name == &m_owned;
+        }
+
+        NotificationId m_id;
+        const std::string * m_name;
+        std::string m_owned;
+        size_t m_hash;
+};
+
+inline bool NotificationKey::matches(const INotification & notification) const
+{
+    NotificationId id = notification.getId();
+    if (id != 0)
+    {
+        NotificationId own = NotificationIds::getInstance()->getTypeIndex(*this);
+        if (own != 0)
+            return id == own;
+    }
+    return isNamed(notification.getName());
+}
+
+#endif //
@@ -0,0 +1,92 @@
+#ifndef __NOTIFICATION_KEY_HPP__
+#define __NOTIFICATION_KEY_HPP__
+#include <string>
+#include <cstddef>
+#include "../../interfaces/inotification.hpp"
+#include "../../utils/hash_func.hpp"
+
+/**
+ * A notification name known at compile time.
+ *
+ * <P>
+ * The name is hashed by the compiler, so sending a
+ * <code>NotificationKey</code> is an integer-keyed lookup of the id
+ * registered for that hash, confirmed by one comparison with the
+ * interned name. <code>NotificationIds</code> rejects two names with
+ * the same hash when the second one is registered, so among registered
+ * names the hash is unique; a key whose name was never registered may
+ * still collide with one that was, which is why the name is
+ * checked.</P>
+ *
+ * <listing>
+ *		static constexpr NotificationKey WALK("walk");
+ *
+ *		interests.push_back( WALK );
+ *		facade->sendNotification( WALK );
+ *
+ *		switch ( notification.getNameHash() )
+ *		{
+ *			case WALK.hash(): ...
+ *		}
+ * </listing>
+ */
+class NotificationKey
+{
+    public:
+        template <size_t N>
+        explicit constexpr NotificationKey(const char (&name)[N])
+            :m_name(name), m_length(N - 1), m_hash(hashString(name, N - 1))
+        {
+        }
+
+        constexpr const char * name() const
+        {
+            return m_name;
+        }
+
+        constexpr size_t length() const
+        {
+            return m_length;
+        }
+
+        constexpr size_t hash() const
+        {
+            return m_hash;
+        }
+
+        /**
+         * The name as a string, e.g. for <code>listNotificationInterests</code>.
+         */
+        operator std::string() const
+        {
+            return std::string(m_name, m_length);
+        }
+
+        /**
+         * Check whether a notification has this name.
+         *
+         * <P>
+         * Compares ids when both the notification and the key are
+         * registered, and the names otherwise. Defined in
+         * notification_ids.hpp.</P>
+         */
+        bool matches(const INotification & notification) const;
+
+        /**
+         * Check whether <code>name</code> is this key's name.
+         */
+        bool isNamed(const std::string & name) const
+        {
+            return name.compare(0, std::string::npos, m_name, m_length) == 0;
+        }
+
+    private:
+        const char * m_name;
+        size_t m_length;
+        size_t m_hash;
+};
+
+// NotificationKey::matches needs NotificationIds, which includes this file
+#include "notification_ids.hpp"
+
+#endif //
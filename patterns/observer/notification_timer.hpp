@@ -0,0 +1,190 @@
+#ifndef __NOTIFICATION_TIMER_HPP__
+#define __NOTIFICATION_TIMER_HPP__
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "../../interfaces/iview.hpp"
+#include "../../utils/timer_wheel.hpp"
+#include "notification.hpp"
+
+/**
+ * Sends <code>Notification</code>s after a delay or periodically.
+ *
+ * <P>
+ * Timers are kept in a <code>TimerWheel</code>, so scheduling and
+ * cancelling take constant time however many are pending. Time moves
+ * on when <code>tick</code> is called, either by the application, for
+ * example from its own main loop, or by the single thread started with
+ * <code>start</code>. Delays count from the current time, or from the
+ * last <code>tick</code> if that was given a later time. Expired
+ * notifications are delivered by the
+ * ticking thread through <code>IView::notifyObservers</code>, exactly
+ * as a synchronous <code>sendNotification</code> would, in expiry
+ * order. Each tick then delivers the <code>IView</code>'s coalesced
+ * notifications whose window has passed.</P>
+ *
+ * <P>
+ * <code>schedule</code> and <code>cancel</code> may be called from any
+ * thread, including from observers of a timed notification. Observers
+ * must not call <code>tick</code>.</P>
+ */
+class NotificationTimer
+{
+    public:
+        typedef std::chrono::steady_clock Clock;
+        typedef TimerWheel<Notification> Wheel;
+
+        /**
+         * @param view the <code>IView</code> to deliver notifications to
+         * @param resolution length of a tick; delays are rounded up to it
+         */
+        explicit NotificationTimer(IView * view, Clock::duration resolution = std::chrono::milliseconds(1))
+            :m_view(view), m_wheel(resolution, Clock::now(), Notification(NotificationId(0))),
+             m_running(false)
+        {
+        }
+
+        /**
+         * Stop the tick thread; pending timers are discarded.
+         */
+        ~NotificationTimer()
+        {
+            stop();
+        }
+
+        /**
+         * Send <code>notification</code> once <code>delay</code> has
+         * passed and, if <code>period</code> is not zero, every
+         * <code>period</code> after that.
+         *
+         * @return the handle to cancel the timer with
+         */
+        TimerId schedule(const Notification & notification, Clock::duration delay, Clock::duration period = Clock::duration(0))
+        {
+            Clock::time_point now = Clock::now();
+            std::lock_guard<std::mutex> lock(m_mutex);
+            return m_wheel.scheduleAfter(notification, delay, period, now);
+        }
+
+        /**
+         * Cancel a timer.
+         *
+         * @return false if it already fired or was cancelled.
+         */
+        bool cancel(const TimerId & timer)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            return m_wheel.cancel(timer);
+        }
+
+        /**
+         * Deliver every notification due by <code>now</code>.
+         *
+         * @return the number of notifications delivered
+         */
+        size_t tick(Clock::time_point now = Clock::now())
+        {
+            // one ticker at a time; the expired notifications are
+            // delivered outside m_mutex so observers can schedule
+            std::lock_guard<std::mutex> ticking(m_tickMutex);
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                Collect collect = { &m_expired };
+                m_wheel.advance(now, collect);
+            }
+            for (size_t i = 0; i < m_expired.size(); ++i)
+            {
+                m_view->notifyObservers(m_expired[i]);
+            }
+            size_t count = m_expired.size();
+            m_expired.clear();
+            return count + m_view->flushExpiredCoalesced(now);
+        }
+
+        /**
+         * Number of timers pending.
+         */
+        size_t pending()
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            return m_wheel.size();
+        }
+
+        /**
+         * Start a thread calling <code>tick</code> once per resolution.
+         */
+        void start()
+        {
+            std::lock_guard<std::mutex> lock(m_threadMutex);
+            if (m_running)
+                return;
+            m_running = true;
+            m_thread = std::thread(&NotificationTimer::run, this);
+        }
+
+        /**
+         * Stop and join the tick thread, if started.
+         */
+        void stop()
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_threadMutex);
+                if (!m_running)
+                    return;
+                m_running = false;
+            }
+            m_wakeup.notify_all();
+            m_thread.join();
+        }
+
+    private:
+        struct Collect
+        {
+            void operator()(const Notification & notification)
+            {
+                expired->push_back(notification);
+            }
+            std::vector<Notification> * expired;
+        };
+
+        void run()
+        {
+            Clock::duration resolution = m_wheel.resolution();
+            Clock::time_point next = Clock::now() + resolution;
+            std::unique_lock<std::mutex> lock(m_threadMutex);
+            while (m_running)
+            {
+                m_wakeup.wait_until(lock, next);
+                if (!m_running)
+                    break;
+                lock.unlock();
+                tick();
+                lock.lock();
+                next += resolution;
+                Clock::time_point now = Clock::now();
+                if (next < now)
+                    next = now;
+            }
+        }
+
+        NotificationTimer(const NotificationTimer &);
+        NotificationTimer & operator = (const NotificationTimer &);
+
+        IView * m_view;
+        // guards m_wheel
+        std::mutex m_mutex;
+        Wheel m_wheel;
+        // serialises tick; guards m_expired
+        std::mutex m_tickMutex;
+        std::vector<Notification> m_expired;
+
+        // guards m_running
+        std::mutex m_threadMutex;
+        std::condition_variable m_wakeup;
+        bool m_running;
+        std::thread m_thread;
+};
+
+#endif //
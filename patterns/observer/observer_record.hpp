@@ -0,0 +1,138 @@
+#ifndef __OBSERVER_RECORD_HPP__
+#define __OBSERVER_RECORD_HPP__
+#include <cstddef>
+#include "../../interfaces/inotification.hpp"
+#include "../../interfaces/iobserver.hpp"
+#include "../../interfaces/imediator.hpp"
+
+/**
+ * One subscriber of a notification, stored by value in the <code>View</code>.
+ *
+ * <P>
+ * A record is the notify context of the subscription plus a target
+ * object and the thunks that call it, so a notification's subscribers
+ * are one contiguous array that dispatch walks without dereferencing a
+ * separate <code>Observer</code> object or making a virtual call per
+ * subscriber. Mediators and commands are stored this way directly;
+ * an <code>IObserver</code> registered through the generic API becomes
+ * a record whose thunks forward to it.</P>
+ */
+struct ObserverRecord
+{
+    typedef NotifyMethod::Thunk Thunk;
+    typedef void (*BatchThunk)(void * target, const INotification * const * notifications, size_t count);
+
+    ObserverRecord()
+        :target(NULL), thunk(NULL), batch(NULL), priority(0), serial(0)
+    {
+    }
+
+    /**
+     * A record calling <code>method</code>; batches are delivered one
+     * notification at a time.
+     */
+    static ObserverRecord fromMethod( const NotifyMethod & method, const NotifyContext & context )
+    {
+        ObserverRecord record;
+        record.context = context;
+        record.target = method.getObject();
+        record.thunk = method.getThunk();
+        return record;
+    }
+
+    /**
+     * A record calling <code>handleNotification</code> and
+     * <code>handleNotifications</code> of a mediator.
+     */
+    static ObserverRecord fromMediator( IMediator * mediator, const NotifyContext & context )
+    {
+        ObserverRecord record = fromMethod(
+                NotifyMethod::bind<IMediator, &IMediator::handleNotification>(mediator), context);
+        record.batch = &invokeMediatorBatch;
+        return record;
+    }
+
+    /**
+     * A record forwarding to an <code>IObserver</code>.
+     */
+    static ObserverRecord fromObserver( IObserver * observer )
+    {
+        ObserverRecord record;
+        record.target = observer;
+        record.thunk = &invokeObserver;
+        record.batch = &invokeObserverBatch;
+        return record;
+    }
+
+    void notify( const INotification & notification ) const
+    {
+        thunk(target, notification);
+    }
+
+    void notify( const INotification * const * notifications, size_t count ) const
+    {
+        if (batch != NULL)
+        {
+            batch(target, notifications, count);
+            return;
+        }
+        for (size_t i = 0; i < count; ++i)
+        {
+            thunk(target, *notifications[i]);
+        }
+    }
+
+    /**
+     * Whether this record was registered with <code>notifyContext</code>.
+     */
+    bool matches( NotifyContext & notifyContext ) const
+    {
+        IObserver * observer = getObserver();
+        if (observer != NULL)
+            return observer->compareNotifyContext(notifyContext);
+        return context == notifyContext;
+    }
+
+    /**
+     * The <code>IObserver</code> this record forwards to, or NULL.
+     */
+    IObserver * getObserver() const
+    {
+        return thunk == &invokeObserver ? static_cast<IObserver *>(target) : NULL;
+    }
+
+    // The context the subscription was registered with
+    NotifyContext context;
+
+    // The object the thunks are called with
+    void * target;
+
+    Thunk thunk;
+
+    // Delivers a run of notifications at once, or NULL to use thunk
+    BatchThunk batch;
+
+    // Higher priorities are notified first
+    int priority;
+
+    // Assigned by the View when the record is registered
+    size_t serial;
+
+    private:
+        static void invokeObserver( void * target, const INotification & notification )
+        {
+            static_cast<IObserver *>(target)->notifyObserver(notification);
+        }
+
+        static void invokeObserverBatch( void * target, const INotification * const * notifications, size_t count )
+        {
+            static_cast<IObserver *>(target)->notifyObserver(notifications, count);
+        }
+
+        static void invokeMediatorBatch( void * target, const INotification * const * notifications, size_t count )
+        {
+            static_cast<IMediator *>(target)->handleNotifications(notifications, count);
+        }
+};
+
+#endif //
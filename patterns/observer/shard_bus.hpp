@@ -0,0 +1,488 @@
+#ifndef __SHARD_BUS_HPP__
+#define __SHARD_BUS_HPP__
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../../core/view.hpp"
+#include "../../utils/spsc_ring.hpp"
+#include "notification.hpp"
+
+/**
+ * Runs one thread per shard and passes notifications between shards
+ * through single-producer/single-consumer rings.
+ *
+ * <P>
+ * Shard <code>i</code> of a bus created with key <code>bus</code> owns
+ * the Multiton core <code>bus/i</code>: its mediators and commands are
+ * registered with <code>View::getInstance("bus/i")</code>, directly or
+ * through a Facade created with that key, and only ever run on the
+ * shard's thread.</P>
+ *
+ * <P>
+ * <code>sendNotification</code> called on a shard's thread delivers
+ * synchronously to that shard's own observers and, for every other
+ * shard whose <code>View</code> has observers for the notification,
+ * pushes it onto the ring from this shard to that one. A ring slot
+ * holds only the notification's id, body pointer and type, the type
+ * interned in <code>NotificationIds</code> like a name, so keep the
+ * set of types small. Every ordered pair of shards has its own ring,
+ * so once a type has been interned the hot path takes no lock and does
+ * not allocate, and notifications from one shard arrive at another in
+ * the order they were sent. If a ring is full the
+ * notification waits in a backlog owned by the sending shard, which
+ * is retried on its next turn; a shard therefore never blocks on a
+ * peer, and two shards flooding each other cannot deadlock.</P>
+ *
+ * <P>
+ * A <code>Facade</code> whose core is a shard routes its
+ * <code>sendNotification</code> calls made on that shard's thread
+ * through the bus, so mediators and commands reach the other shards
+ * without knowing about the bus.</P>
+ *
+ * <P>
+ * Called from any other thread, <code>sendNotification</code> queues
+ * the notification to each interested shard through a locked inbox.</P>
+ *
+ * <P>
+ * The body of a <code>TypedNotification</code> lives inside the
+ * notification, on the sender's stack, so typed notifications are only
+ * delivered to the sending shard.</P>
+ *
+ * <P>
+ * Shard threads poll their rings and yield when idle; after
+ * <code>IDLE_TURNS</code> empty turns in a row a shard parks on a
+ * condition variable until a notification is sent to it, so idle
+ * shards do not keep a core busy. The bus does not destroy the shard
+ * cores; use <code>View::destroyInstance(key)</code>
+ * or the Facade's <code>destroyInstance(key)</code> after the bus.</P>
+ */
+class ShardBus
+{
+    public:
+        // empty polls before an idle shard parks
+        enum { IDLE_TURNS = 64 };
+
+        /**
+         * Start the shards.
+         *
+         * @param key prefix of the shards' Multiton keys
+         * @param shards number of shards, one thread each
+         * @param capacity bound of each ring between two shards
+         */
+        ShardBus(const std::string & key, size_t shards, size_t capacity = 1024)
+            :m_running(true)
+        {
+            if (shards == 0)
+                shards = 1;
+            for (size_t i = 0; i < shards; ++i)
+            {
+                m_shards.push_back(new Shard(key + "/" + std::to_string(i)));
+            }
+            for (size_t from = 0; from < shards; ++from)
+            {
+                for (size_t to = 0; to < shards; ++to)
+                {
+                    m_shards[from]->outbound.push_back(from == to ? NULL : new Channel(capacity));
+                }
+            }
+            for (size_t i = 0; i < shards; ++i)
+            {
+                m_threads.push_back(std::thread(&ShardBus::run, this, i));
+            }
+        }
+
+        /**
+         * Stop and join the shard threads; undelivered notifications are dropped.
+         */
+        ~ShardBus()
+        {
+            m_running.store(false, std::memory_order_release);
+            for (size_t i = 0; i < m_shards.size(); ++i)
+            {
+                {
+                    std::lock_guard<std::mutex> lock(m_shards[i]->parkMutex);
+                }
+                m_shards[i]->wakeup.notify_one();
+            }
+            for (size_t i = 0; i < m_threads.size(); ++i)
+            {
+                m_threads[i].join();
+            }
+            for (size_t i = 0; i < m_shards.size(); ++i)
+            {
+                delete m_shards[i];
+            }
+        }
+
+        size_t size() const
+        {
+            return m_shards.size();
+        }
+
+        /**
+         * The Multiton key of a shard's core.
+         */
+        const std::string & getShardKey(size_t shard) const
+        {
+            return m_shards[shard]->key;
+        }
+
+        /**
+         * The <code>View</code> of a shard's core.
+         */
+        View * getView(size_t shard) const
+        {
+            return m_shards[shard]->view;
+        }
+
+        /**
+         * The bus whose shard thread is calling, or NULL.
+         */
+        static ShardBus * current()
+        {
+            return currentSlot().bus;
+        }
+
+        /**
+         * The index of the shard thread calling; only valid if <code>current()</code> is not NULL.
+         */
+        static size_t currentShard()
+        {
+            return currentSlot().shard;
+        }
+
+        /**
+         * Deliver a notification to every shard that observes it.
+         *
+         * @param notification the notification to route
+         * @throws std::invalid_argument for a typed notification sent from outside the bus
+         */
+        void sendNotification(const INotification & notification)
+        {
+            NotificationId id = NotificationIds::resolve(notification);
+            void * body = const_cast<INotification &>(notification).getBody();
+            CurrentSlot & slot = currentSlot();
+            if (slot.bus != this)
+            {
+                if (notification.getBodyTag() != NULL)
+                    throw std::invalid_argument("ShardBus: a typed notification cannot leave its sender");
+                for (size_t to = 0; to < m_shards.size(); ++to)
+                {
+                    if (!m_shards[to]->view->hasObservers(id))
+                        continue;
+                    m_shards[to]->inbox.push(Notification(id, body, notification.getType()));
+                    wake(m_shards[to]);
+                }
+                return;
+            }
+
+            Shard * shard = m_shards[slot.shard];
+            if (notification.getBodyTag() == NULL)
+            {
+                Routed routed;
+                routed.id = id;
+                routed.body = body;
+                routed.type = 0;
+                for (size_t to = 0; to < m_shards.size(); ++to)
+                {
+                    if (to == slot.shard || !m_shards[to]->view->hasObservers(id))
+                        continue;
+                    if (routed.type == 0 && !notification.getType().empty())
+                        routed.type = NotificationIds::getInstance()->registerType(notification.getType());
+                    shard->outbound[to]->send(routed);
+                    wake(m_shards[to]);
+                }
+            }
+            shard->view->notifyObservers(notification);
+        }
+
+        /**
+         * Wait until every notification sent so far, and every one those
+         * caused, has been delivered. Must not be called from a shard thread.
+         */
+        void flush()
+        {
+            for (;;)
+            {
+                // A notification is counted as sent before it can be
+                // delivered, and a delivery is counted only after its
+                // handlers, and whatever they sent, have returned. Reading
+                // every delivered count before any sent count therefore
+                // sees them equal only once nothing is in flight.
+                size_t done = 0;
+                size_t sent = 0;
+                for (size_t i = 0; i < m_shards.size(); ++i)
+                    done += m_shards[i]->delivered();
+                for (size_t i = 0; i < m_shards.size(); ++i)
+                    sent += m_shards[i]->sent();
+                if (sent == done)
+                    return;
+                std::this_thread::yield();
+            }
+        }
+
+    private:
+        // What crosses a ring: no strings, so filling a slot never allocates
+        struct Routed
+        {
+            NotificationId id;
+            void * body;
+            // interned type, 0 for none
+            NotificationId type;
+        };
+
+        // The ring from one shard to another plus the sender's backlog
+        struct Channel
+        {
+            explicit Channel(size_t capacity)
+                :ring(capacity), sent(0), delivered(0)
+            {
+            }
+
+            // Producer side: keep order behind anything already backlogged
+            void send(const Routed & routed)
+            {
+                sent.store(sent.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+                if (backlog.empty() && ring.tryPush(routed))
+                    return;
+                backlog.push_back(routed);
+            }
+
+            // Producer side: move what fits from the backlog to the ring
+            bool retry()
+            {
+                while (!backlog.empty() && ring.tryPush(backlog.front()))
+                {
+                    backlog.pop_front();
+                }
+                return backlog.empty();
+            }
+
+            SpscRing<Routed> ring;
+            std::deque<Routed> backlog;
+            // written by the producer only
+            std::atomic<size_t> sent;
+            // written by the consumer only
+            std::atomic<size_t> delivered;
+        };
+
+        // Notifications sent to a shard from threads outside the bus
+        struct Inbox
+        {
+            Inbox()
+                :posted(0), delivered(0)
+            {
+            }
+
+            void push(const Notification & notification)
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                items.push_back(notification);
+                posted.fetch_add(1, std::memory_order_release);
+            }
+
+            std::mutex mutex;
+            std::deque<Notification> items;
+            std::atomic<size_t> posted;
+            std::atomic<size_t> delivered;
+        };
+
+        struct Shard
+        {
+            explicit Shard(const std::string & key)
+                :key(key), view(View::getInstance(key)), sleeping(0)
+            {
+            }
+
+            ~Shard()
+            {
+                for (size_t i = 0; i < outbound.size(); ++i)
+                {
+                    delete outbound[i];
+                }
+            }
+
+            size_t sent() const
+            {
+                size_t count = inbox.posted.load(std::memory_order_acquire);
+                for (size_t i = 0; i < outbound.size(); ++i)
+                {
+                    if (outbound[i] != NULL)
+                        count += outbound[i]->sent.load(std::memory_order_acquire);
+                }
+                return count;
+            }
+
+            size_t delivered() const
+            {
+                size_t count = inbox.delivered.load(std::memory_order_acquire);
+                for (size_t i = 0; i < outbound.size(); ++i)
+                {
+                    if (outbound[i] != NULL)
+                        count += outbound[i]->delivered.load(std::memory_order_acquire);
+                }
+                return count;
+            }
+
+            std::string key;
+            View * view;
+            // Channel to every other shard, NULL for this one
+            std::vector<Channel *> outbound;
+            Inbox inbox;
+
+            // parking of the idle shard thread
+            std::mutex parkMutex;
+            std::condition_variable wakeup;
+            // 1 while the thread is parked or about to park
+            std::atomic<int> sleeping;
+        };
+
+        struct CurrentSlot
+        {
+            ShardBus * bus;
+            size_t shard;
+        };
+
+        static CurrentSlot & currentSlot()
+        {
+            static thread_local CurrentSlot s_slot = { NULL, 0 };
+            return s_slot;
+        }
+
+        // One turn of a shard: retry backlogs, then drain the inbox and
+        // every ring into this shard. What comes off a ring is delivered
+        // as delivery, reused so its strings keep their storage.
+        // Returns whether anything was done.
+        bool poll(size_t index, Notification & delivery)
+        {
+            Shard * shard = m_shards[index];
+            bool busy = false;
+            for (size_t to = 0; to < m_shards.size(); ++to)
+            {
+                Channel * channel = shard->outbound[to];
+                if (channel != NULL && !channel->backlog.empty())
+                {
+                    busy = true;
+                    channel->retry();
+                    wake(m_shards[to]);
+                }
+            }
+
+            Inbox & inbox = shard->inbox;
+            if (inbox.posted.load(std::memory_order_acquire) != inbox.delivered.load(std::memory_order_relaxed))
+            {
+                std::deque<Notification> items;
+                {
+                    std::lock_guard<std::mutex> lock(inbox.mutex);
+                    items.swap(inbox.items);
+                }
+                for (size_t i = 0; i < items.size(); ++i)
+                {
+                    shard->view->notifyObservers(items[i]);
+                    inbox.delivered.store(inbox.delivered.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+                }
+                busy = true;
+            }
+
+            Routed routed;
+            for (size_t from = 0; from < m_shards.size(); ++from)
+            {
+                Channel * channel = m_shards[from]->outbound[index];
+                if (channel == NULL)
+                    continue;
+                while (channel->ring.tryPop(routed))
+                {
+                    delivery = Notification(routed.id, routed.body);
+                    if (routed.type != 0)
+                        delivery.setType(NotificationIds::getInstance()->getName(routed.type));
+                    shard->view->notifyObservers(delivery);
+                    channel->delivered.store(channel->delivered.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+                    busy = true;
+                }
+            }
+            return busy;
+        }
+
+        // Whether a shard has anything to deliver or retry; called by the
+        // shard's own thread
+        bool hasWork(size_t index) const
+        {
+            const Shard * shard = m_shards[index];
+            if (shard->inbox.posted.load() != shard->inbox.delivered.load(std::memory_order_relaxed))
+                return true;
+            for (size_t i = 0; i < m_shards.size(); ++i)
+            {
+                const Channel * out = shard->outbound[i];
+                if (out != NULL && !out->backlog.empty())
+                    return true;
+                const Channel * in = m_shards[i]->outbound[index];
+                if (in != NULL && !in->ring.empty())
+                    return true;
+            }
+            return false;
+        }
+
+        // Called after making work visible to a shard. Both this and park
+        // update sleeping with a read-modify-write, so one of them comes
+        // second and sees the other: either the shard sees the work
+        // before it sleeps, or this sees it sleeping and notifies it
+        static void wake(Shard * shard)
+        {
+            if (shard->sleeping.fetch_add(0, std::memory_order_acq_rel) == 0)
+                return;
+            {
+                std::lock_guard<std::mutex> lock(shard->parkMutex);
+            }
+            shard->wakeup.notify_one();
+        }
+
+        void park(size_t index)
+        {
+            Shard * shard = m_shards[index];
+            std::unique_lock<std::mutex> lock(shard->parkMutex);
+            shard->sleeping.exchange(1, std::memory_order_acq_rel);
+            if (!hasWork(index) && m_running.load())
+                shard->wakeup.wait(lock);
+            shard->sleeping.store(0, std::memory_order_relaxed);
+        }
+
+        void run(size_t index)
+        {
+            CurrentSlot & slot = currentSlot();
+            slot.bus = this;
+            slot.shard = index;
+
+            Notification delivery(NotificationId(0));
+            size_t idle = 0;
+            while (m_running.load(std::memory_order_acquire))
+            {
+                if (poll(index, delivery))
+                {
+                    idle = 0;
+                    continue;
+                }
+                if (++idle < IDLE_TURNS)
+                {
+                    std::this_thread::yield();
+                    continue;
+                }
+                park(index);
+                idle = 0;
+            }
+            slot.bus = NULL;
+        }
+
+        ShardBus(const ShardBus &);
+        ShardBus & operator = (const ShardBus &);
+
+        std::vector<Shard *> m_shards;
+        std::vector<std::thread> m_threads;
+        std::atomic<bool> m_running;
+};
+
+#endif //
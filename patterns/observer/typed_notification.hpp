@@ -0,0 +1,152 @@
+#ifndef __TYPED_NOTIFICATION_HPP__
+#define __TYPED_NOTIFICATION_HPP__
+#include <string>
+#include <utility>
+#include "../../interfaces/inotification.hpp"
+#include "notification_ids.hpp"
+
+/**
+ * The <code>BodyTag</code> of a C++ type.
+ *
+ * <P>
+ * Each type gets the address of its own static, so comparing tags is
+ * a pointer compare and needs neither RTTI nor strings.</P>
+ */
+template <class T>
+struct BodyTagOf
+{
+    static BodyTag tag()
+    {
+        return &s_tag;
+    }
+
+    private:
+        static const char s_tag;
+};
+
+template <class T> const char BodyTagOf<T>::s_tag = 0;
+
+/**
+ * A <code>INotification</code> carrying a body of type <code>T</code>.
+ *
+ * <P>
+ * The body is stored inside the notification itself, so sending one
+ * from the stack needs no heap allocation for the payload. The
+ * notification is move-only: the body is moved in at construction and
+ * handlers read it in place with <code>notification_cast</code>:</P>
+ *
+ * <listing>
+ *		const Position * pos = notification_cast<Position>( notification );
+ *		if ( pos != NULL ) ...
+ * </listing>
+ *
+ * <P>
+ * <code>getBody</code> still returns the address of the body for code
+ * written against the untyped API.</P>
+ */
+template <class T>
+class TypedNotification : public INotification
+{
+    public:
+        TypedNotification( NotificationId id, T body, const std::string & type = "" )
+            :m_name(id), m_type(type), m_body(std::move(body))
+        {
+        }
+
+        TypedNotification( const std::string & name, T body, const std::string & type = "" )
+            :m_name(name), m_type(type), m_body(std::move(body))
+        {
+        }
+
+        TypedNotification( TypedNotification && other )
+            :m_name(other.m_name), m_type(std::move(other.m_type)),
+             m_body(std::move(other.m_body))
+        {
+        }
+
+        const std::string & getName() const
+        {
+            return m_name.str();
+        }
+
+        NotificationId getId() const
+        {
+            return m_name.id();
+        }
+
+        size_t getNameHash() const
+        {
+            return m_name.hash();
+        }
+
+        BodyTag getBodyTag() const
+        {
+            return BodyTagOf<T>::tag();
+        }
+
+        /**
+         * Get the body in place.
+         */
+        const T & getTypedBody() const
+        {
+            return m_body;
+        }
+
+        T & getTypedBody()
+        {
+            return m_body;
+        }
+
+        /**
+         * The body of a <code>TypedNotification</code> is fixed at
+         * construction; untyped bodies are ignored.
+         */
+        void setBody( void * )
+        {
+        }
+
+        void * getBody()
+        {
+            return &m_body;
+        }
+
+        void setType( const std::string & type )
+        {
+            m_type = type;
+        }
+
+        const std::string & getType() const
+        {
+            return m_type;
+        }
+
+        std::string toString()
+        {
+            std::string msg = std::string("Notification Name: ") + m_name.str();
+            msg += "\nType:" + m_type;
+            return msg;
+        }
+
+    private:
+        TypedNotification( const TypedNotification & );
+        TypedNotification & operator = ( const TypedNotification & );
+
+        NotificationName m_name;
+        std::string m_type;
+        T m_body;
+};
+
+/**
+ * Get the body of a notification if it is a <code>TypedNotification&lt;T&gt;</code>.
+ *
+ * @return the body, or NULL if the notification carries another type.
+ */
+template <class T>
+const T * notification_cast( const INotification & notification )
+{
+    if (notification.getBodyTag() != BodyTagOf<T>::tag())
+        return NULL;
+    return &static_cast<const TypedNotification<T> &>(notification).getTypedBody();
+}
+
+#endif //
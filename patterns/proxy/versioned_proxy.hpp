@@ -0,0 +1,299 @@
+#ifndef __VERSIONED_PROXY_HPP__
+#define __VERSIONED_PROXY_HPP__
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <stdint.h>
+#include "../../interfaces/iproxy.hpp"
+#include "../../utils/epoch.hpp"
+#include "../observer/notification.hpp"
+#include "../observer/notification_ids.hpp"
+#include "../observer/notifier.hpp"
+#include "proxy.hpp"
+
+/**
+ * A <code>Proxy</code> whose data of type <code>D</code> is published
+ * as immutable, versioned snapshots.
+ *
+ * <P>
+ * Writers never modify the data in place: <code>publish</code> and
+ * <code>update</code> build a new snapshot under a mutex, swap it in
+ * with an atomic store and retire the old one to an
+ * <code>EpochDomain</code>. Readers on any thread take a
+ * <code>Reader</code>, which pins the current snapshot without a lock,
+ * so they never see a half-written update.</P>
+ *
+ * <P>
+ * Every snapshot carries a version that grows by one per publish.
+ * <code>getVersion</code> is a single atomic load, so a consumer that
+ * remembers the version it last saw can skip unchanged data without
+ * reading or comparing it; <code>readIfChanged</code> does both.</P>
+ *
+ * <P>
+ * After <code>setChangeNotification</code>, every publish that moves
+ * the version sends a notification of that name, with this proxy as
+ * its body, through the given <code>INotifier</code>, usually the
+ * Facade. It is sent after the writer lock is released, so observers
+ * may read or update the proxy.</P>
+ *
+ * <listing>
+ *		VersionedProxy<Prices> * prices = new VersionedProxy<Prices>("prices");
+ *		prices->setChangeNotification(facade, "pricesChanged");
+ *		facade->registerProxy(prices);
+ *
+ *		// in a mediator
+ *		if (prices->readIfChanged(m_seen, m_prices))
+ *			redraw(m_prices);
+ * </listing>
+ */
+template <class D>
+class VersionedProxy : public Proxy
+{
+    public:
+        /**
+         * One published state of the data.
+         */
+        struct Snapshot
+        {
+            Snapshot(const D & d, uint64_t v)
+                :data(d), version(v)
+            {
+            }
+
+            const D data;
+            const uint64_t version;
+        };
+
+        /**
+         * Pins the snapshot current at construction until destroyed.
+         */
+        class Reader
+        {
+            public:
+                explicit Reader(const VersionedProxy & proxy)
+                    :m_guard(proxy.m_epoch), m_snapshot(proxy.m_snapshot.load(std::memory_order_acquire))
+                {
+                }
+
+                const D & operator * () const
+                {
+                    return m_snapshot->data;
+                }
+
+                const D * operator -> () const
+                {
+                    return &m_snapshot->data;
+                }
+
+                uint64_t version() const
+                {
+                    return m_snapshot->version;
+                }
+
+            private:
+                Reader(const Reader &);
+                Reader & operator = (const Reader &);
+
+                EpochDomain::Guard m_guard;
+                const Snapshot * m_snapshot;
+        };
+
+        /**
+         * @param proxyName the proxy name
+         * @param data the initial data, published as version 0
+         */
+        explicit VersionedProxy(const std::string & proxyName, const D & data = D())
+            :Proxy(proxyName), m_snapshot(new Snapshot(data, 0)), m_version(0),
+             m_serial(nextSerial()), m_notifier(NULL), m_changeId(0)
+        {
+            m_data = NULL;
+        }
+
+        virtual ~VersionedProxy()
+        {
+            delete m_snapshot.load();
+        }
+
+        /**
+         * The version of the current snapshot.
+         */
+        uint64_t getVersion() const
+        {
+            return m_version.load(std::memory_order_acquire);
+        }
+
+        /**
+         * Copy the data out if its version differs from <code>seen</code>.
+         *
+         * @param seen the version last read; updated when data is copied
+         * @param data receives a copy of the current data
+         * @return whether the data changed since <code>seen</code>
+         */
+        bool readIfChanged(uint64_t & seen, D & data) const
+        {
+            if (getVersion() == seen)
+                return false;
+            Reader reader(*this);
+            data = *reader;
+            seen = reader.version();
+            return true;
+        }
+
+        /**
+         * Publish new data as the next version.
+         *
+         * @return the new version
+         */
+        uint64_t publish(const D & data)
+        {
+            uint64_t version;
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                version = publishLocked(data);
+            }
+            notifyChanged();
+            return version;
+        }
+
+        /**
+         * Apply <code>modify</code> to a copy of the current data and
+         * publish the result, unless <code>modify</code> returns false,
+         * in which case the version does not move and nothing is sent.
+         *
+         * @param modify called as <code>bool modify(D &)</code> under the writer lock
+         * @return whether a new version was published
+         */
+        template <class F>
+        bool update(F modify)
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                D data = m_snapshot.load(std::memory_order_relaxed)->data;
+                if (!modify(data))
+                    return false;
+                publishLocked(data);
+            }
+            notifyChanged();
+            return true;
+        }
+
+        /**
+         * Send a notification named <code>notificationName</code>
+         * through <code>notifier</code> whenever the version moves;
+         * pass NULL to stop.
+         */
+        void setChangeNotification(INotifier * notifier, const std::string & notificationName = "")
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_changeId = notifier != NULL ? NotificationIds::getInstance()->registerType(notificationName) : 0;
+            m_notifier = notifier;
+        }
+
+        /**
+         * Publish a copy of <code>*(D *)data</code>.
+         */
+        virtual void setData(void * data)
+        {
+            if (data != NULL)
+                publish(*static_cast<const D *>(data));
+        }
+
+        /**
+         * A copy of the current data owned by the calling thread.
+         *
+         * <P>
+         * Snapshots can be reclaimed as soon as a later one is
+         * published, so the generic <code>IProxy</code> API gets a
+         * per-thread copy instead, refreshed only when the version has
+         * moved. The pointer stays valid until the same thread calls
+         * <code>getData</code> on any <code>VersionedProxy</code> of
+         * the same <code>D</code>. Writing through it does not change the
+         * proxy; use <code>setData</code> or <code>publish</code>. Code
+         * that knows the type should prefer a <code>Reader</code>, which
+         * does not copy.</P>
+         */
+        virtual void * getData()
+        {
+            ThreadCopy & copy = threadCopy();
+            if (copy.owner != m_serial || copy.version != getVersion())
+            {
+                Reader reader(*this);
+                copy.data = *reader;
+                copy.version = reader.version();
+                copy.owner = m_serial;
+            }
+            return &copy.data;
+        }
+
+    private:
+        // What getData last copied on a thread, and from which proxy
+        struct ThreadCopy
+        {
+            ThreadCopy()
+                :owner(0), version(0)
+            {
+            }
+
+            uint64_t owner;
+            uint64_t version;
+            D data;
+        };
+
+        static ThreadCopy & threadCopy()
+        {
+            static thread_local ThreadCopy s_copy;
+            return s_copy;
+        }
+
+        // Identifies a proxy in ThreadCopy; unlike its address, never reused
+        static uint64_t nextSerial()
+        {
+            static std::atomic<uint64_t> s_next(1);
+            return s_next.fetch_add(1);
+        }
+
+        // The mutex is held
+        uint64_t publishLocked(const D & data)
+        {
+            const Snapshot * current = m_snapshot.load(std::memory_order_relaxed);
+            uint64_t version = current->version + 1;
+            m_snapshot.store(new Snapshot(data, version), std::memory_order_release);
+            m_version.store(version, std::memory_order_release);
+            m_epoch.retire(current);
+            return version;
+        }
+
+        void notifyChanged()
+        {
+            INotifier * notifier;
+            NotificationId id;
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                notifier = m_notifier;
+                id = m_changeId;
+            }
+            if (notifier != NULL)
+                notifier->sendNotification(Notification(id, this));
+        }
+
+        VersionedProxy(const VersionedProxy &);
+        VersionedProxy & operator = (const VersionedProxy &);
+
+        std::atomic<const Snapshot *> m_snapshot;
+
+        // version of m_snapshot, stored after it
+        std::atomic<uint64_t> m_version;
+
+        const uint64_t m_serial;
+
+        // Reclaims replaced snapshots
+        EpochDomain m_epoch;
+
+        // Serialises writers; guards m_notifier and m_changeId
+        std::mutex m_mutex;
+
+        INotifier * m_notifier;
+        NotificationId m_changeId;
+};
+
+#endif //
@@ -0,0 +1,1321 @@
+// the container hash_map replaced, kept here as a baseline
+#define _GLIBCXX_PERMIT_BACKWARD_HASH
+#include <ext/hash_map>
+#include <unordered_map>
+// the callback type NotifyMethod replaced, kept here as a baseline
+#include <boost/function.hpp>
+#include <boost/bind/bind.hpp>
+
+#include "utils/hash_func.hpp"
+#include "../interfaces/inotification.hpp"
+#include "../interfaces/imediator.hpp"
+#include "../interfaces/ifacade.hpp"
+#include "../interfaces/icontroller.hpp"
+#include "../core/view.hpp"
+#include "../core/model.hpp"
+#include "../core/controller.hpp"
+#include "../patterns/facade/facade.hpp"
+#include "../patterns/command/simple_command.hpp"
+#include "../patterns/command/macro_command.hpp"
+#include "../patterns/command/parallel_macro_command.hpp"
+#include "../patterns/proxy/proxy.hpp"
+#include "../patterns/proxy/versioned_proxy.hpp"
+#include "../patterns/observer/shard_bus.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <vector>
+
+/**
+ * Microbenchmarks for the framework's hot paths.
+ *
+ * <P>
+ * Every benchmark runs its operation in a number of equally sized
+ * batches and reports the mean cost per operation, the 50th and 99th
+ * percentile of the per-batch cost, and the heap allocations made per
+ * operation. Run with a benchmark name as argument to run only the
+ * benchmarks whose name starts with it, e.g. <code>benchmark map</code>.</P>
+ */
+
+typedef std::chrono::steady_clock Clock;
+
+// Count every heap allocation and release made by the process
+static std::atomic<size_t> s_allocations(0);
+static std::atomic<size_t> s_frees(0);
+
+// Kept out of line: once inlined, GCC sees free() called on memory from
+// operator new and warns with -Wmismatched-new-delete
+#if defined(__GNUC__)
+#define COUNTED_ALLOC __attribute__((noinline))
+#else
+#define COUNTED_ALLOC
+#endif
+
+COUNTED_ALLOC void * operator new(size_t size)
+{
+	s_allocations.fetch_add(1, std::memory_order_relaxed);
+	void * p = malloc(size ? size : 1);
+	if (p == NULL)
+		throw std::bad_alloc();
+	return p;
+}
+
+COUNTED_ALLOC void operator delete(void * p) throw()
+{
+	if (p != NULL)
+		s_frees.fetch_add(1, std::memory_order_relaxed);
+	free(p);
+}
+
+COUNTED_ALLOC void operator delete(void * p, size_t) throw()
+{
+	if (p != NULL)
+		s_frees.fetch_add(1, std::memory_order_relaxed);
+	free(p);
+}
+
+COUNTED_ALLOC void * operator new[](size_t size)
+{
+	return operator new(size);
+}
+
+COUNTED_ALLOC void operator delete[](void * p) throw()
+{
+	operator delete(p);
+}
+
+COUNTED_ALLOC void operator delete[](void * p, size_t) throw()
+{
+	operator delete(p);
+}
+
+static const char * s_filter = NULL;
+
+// true if the filter selects the label, or some label starting with it
+static bool selected(const char * label)
+{
+	if (s_filter == NULL)
+		return true;
+	size_t length = std::min(strlen(label), strlen(s_filter));
+	return strncmp(label, s_filter, length) == 0;
+}
+
+static void printHeader()
+{
+	printf("%-32s %10s %10s %10s %10s\n", "benchmark", "ns/op", "p50", "p99", "allocs/op");
+}
+
+/**
+ * Run <code>op(i)</code> for <code>samples * batch</code> values of
+ * <code>i</code> and print one result line.
+ */
+template <class Op>
+static void measure(const char * label, Op & op, int samples, long batch)
+{
+	if (!selected(label))
+		return;
+
+	// warm up caches and any lazily built tables
+	for (long i = 0; i < batch; ++i)
+	{
+		op(i);
+	}
+
+	std::vector<double> perOp;
+	double total = 0;
+	size_t before = s_allocations.load();
+	for (int s = 0; s < samples; ++s)
+	{
+		Clock::time_point start = Clock::now();
+		for (long i = 0; i < batch; ++i)
+		{
+			op(s * batch + i);
+		}
+		double ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+		perOp.push_back(ns / batch);
+		total += ns;
+	}
+	size_t allocations = s_allocations.load() - before;
+
+	std::sort(perOp.begin(), perOp.end());
+	double ops = double(samples) * batch;
+	printf("%-32s %10.1f %10.1f %10.1f %10.2f\n", label, total / ops,
+	       perOp[perOp.size() / 2], perOp[(perOp.size() * 99) / 100],
+	       double(allocations) / ops);
+}
+
+class BenchFacade : public Facade<BenchFacade>
+{
+public:
+	BenchFacade() {}
+	BenchFacade(const std::string & key) : Facade<BenchFacade>(key) {}
+};
+
+class BenchMediator : public Mediator
+{
+public:
+	BenchMediator(const std::string & name, const std::string & interest)
+		: Mediator(name), m_interest(interest), m_count(0) {}
+
+	virtual Interests listNotificationInterests()
+	{
+		Interests interests;
+		interests.push_back(m_interest);
+		return interests;
+	}
+
+	virtual void handleNotification(const INotification & notification)
+	{
+		m_count.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	virtual void handleNotifications(const INotification * const * notifications, size_t count)
+	{
+		m_count.fetch_add(count, std::memory_order_relaxed);
+	}
+	std::string m_interest;
+	std::atomic<long> m_count;
+};
+
+// Compares the notification name like a typical handleNotification
+class NameMediator : public Mediator
+{
+public:
+	NameMediator(const std::string & name) : Mediator(name), m_count(0) {}
+
+	virtual Interests listNotificationInterests()
+	{
+		Interests interests;
+		interests.push_back("application/state/changed");
+		return interests;
+	}
+
+	virtual void handleNotification(const INotification & notification)
+	{
+		const std::string & name = notification.getName();
+		if (name == "application/state/changed")
+			++m_count;
+	}
+	long m_count;
+};
+
+class BenchCommand : public SimpleCommand
+{
+public:
+	BenchCommand() : m_count(0) {}
+
+	virtual void execute(const INotification & notification)
+	{
+		++m_count;
+	}
+	long m_count;
+};
+
+// Burns a fixed amount of CPU per execution
+class SpinCommand : public SimpleCommand
+{
+public:
+	SpinCommand(long iterations) : m_iterations(iterations), m_sink(0) {}
+
+	virtual void execute(const INotification & notification)
+	{
+		unsigned long x = 1;
+		for (long i = 0; i < m_iterations; ++i)
+		{
+			x = x * 6364136223846793005UL + 1442695040888963407UL;
+		}
+		m_sink.fetch_add(x & 1, std::memory_order_relaxed);
+	}
+	long m_iterations;
+	std::atomic<unsigned long> m_sink;
+};
+
+struct SendById
+{
+	void operator()(long)
+	{
+		facade->sendNotification(id);
+	}
+	BenchFacade * facade;
+	NotificationId id;
+};
+
+struct SendByName
+{
+	void operator()(long)
+	{
+		facade->sendNotification(name);
+	}
+	BenchFacade * facade;
+	std::string name;
+};
+
+// sendNotification to 1, 10 and 1000 observers, by id and by name
+static void benchSendNotification()
+{
+	if (!selected("sendNotification/"))
+		return;
+
+	BenchFacade * facade = BenchFacade::getInstance();
+	const int counts[] = {1, 10, 1000};
+	for (size_t c = 0; c < sizeof(counts) / sizeof(counts[0]); ++c)
+	{
+		char interest[32];
+		sprintf(interest, "bench/%dobs", counts[c]);
+		for (int i = 0; i < counts[c]; ++i)
+		{
+			char name[48];
+			sprintf(name, "%s/%d", interest, i);
+			facade->registerMediator(new BenchMediator(name, interest));
+		}
+		long batch = 100000 / counts[c] + 10;
+
+		SendById byId = {facade, NotificationIds::getInstance()->registerType(interest)};
+		char label[64];
+		sprintf(label, "sendNotification/id/%d", counts[c]);
+		measure(label, byId, 100, batch);
+
+		SendByName byName = {facade, interest};
+		sprintf(label, "sendNotification/name/%d", counts[c]);
+		measure(label, byName, 100, batch);
+	}
+}
+
+// A high priority mediator that consumes what it handles
+class ConsumingMediator : public BenchMediator
+{
+public:
+	ConsumingMediator(const std::string & name, const std::string & interest)
+		: BenchMediator(name, interest) {}
+
+	virtual int getPriority()
+	{
+		return 1;
+	}
+
+	virtual void handleNotification(const INotification & notification)
+	{
+		BenchMediator::handleNotification(notification);
+		View::stopPropagation();
+	}
+};
+
+// 1000 observers, the last one registered at a higher priority stops the rest
+static void benchStopPropagation()
+{
+	if (!selected("sendNotification/stop"))
+		return;
+
+	BenchFacade * facade = BenchFacade::getInstance();
+	for (int i = 0; i < 1000; ++i)
+	{
+		char name[48];
+		sprintf(name, "bench/stop/%d", i);
+		facade->registerMediator(new BenchMediator(name, "bench/stop"));
+	}
+	facade->registerMediator(new ConsumingMediator("bench/stop/consumer", "bench/stop"));
+
+	SendById byId = {facade, NotificationIds::getInstance()->registerType("bench/stop")};
+	measure("sendNotification/stop/1000", byId, 100, 10000);
+}
+
+// A burst of identical notifications followed by a flush
+struct SendBurst
+{
+	void operator()(long)
+	{
+		for (int i = 0; i < 100; ++i)
+		{
+			facade->sendNotification(id);
+		}
+		facade->flushCoalesced();
+	}
+	BenchFacade * facade;
+	NotificationId id;
+};
+
+// Bursts of 100 to 10 mediators, delivered one by one and coalesced
+static void benchCoalescing()
+{
+	if (!selected("coalesce"))
+		return;
+
+	BenchFacade * facade = BenchFacade::getInstance();
+	for (int i = 0; i < 10; ++i)
+	{
+		char name[48];
+		sprintf(name, "bench/coalesce/%d", i);
+		facade->registerMediator(new BenchMediator(name, "bench/coalesce"));
+	}
+	SendBurst burst = {facade, NotificationIds::getInstance()->registerType("bench/coalesce")};
+	measure("coalesce/off/burst100", burst, 100, 100);
+	facade->coalesceNotifications("bench/coalesce");
+	measure("coalesce/on/burst100", burst, 100, 100);
+	facade->stopCoalescing("bench/coalesce");
+}
+
+// Schedule and cancel one timer among 100k pending ones
+struct ScheduleCancel
+{
+	void operator()(long i)
+	{
+		TimerId timer = wheel->schedule(i, start + std::chrono::milliseconds(i % 100000 + 1));
+		wheel->cancel(timer);
+	}
+	TimerWheel<long> * wheel;
+	Clock::time_point start;
+};
+
+struct CountFired
+{
+	void operator()(long)
+	{
+		++count;
+	}
+	long count;
+};
+
+// Advance one tick with 100k periodic timers pending, 1000 due per tick
+struct AdvanceTick
+{
+	void operator()(long)
+	{
+		now += std::chrono::milliseconds(1);
+		wheel->advance(now, fired);
+	}
+	TimerWheel<long> * wheel;
+	Clock::time_point now;
+	CountFired fired;
+};
+
+static void benchTimers()
+{
+	if (!selected("timers"))
+		return;
+
+	Clock::time_point start = Clock::now();
+	TimerWheel<long> pending(std::chrono::milliseconds(1), start);
+	for (long i = 0; i < 100000; ++i)
+	{
+		pending.schedule(i, start + std::chrono::milliseconds(i + 1));
+	}
+	ScheduleCancel scheduleCancel = {&pending, start};
+	measure("timers/schedule+cancel/100k", scheduleCancel, 100, 10000);
+
+	TimerWheel<long> periodic(std::chrono::milliseconds(1), start);
+	for (long i = 0; i < 100000; ++i)
+	{
+		periodic.schedule(i, start + std::chrono::milliseconds(i % 100 + 1), std::chrono::milliseconds(100));
+	}
+	AdvanceTick tick = {&periodic, start, {0}};
+	measure("timers/tick/1000due", tick, 100, 100);
+}
+
+// Allocations made by sending a long, non-SSO name to 10 mediators
+static void benchNameAllocations()
+{
+	if (!selected("sendNotification/longname"))
+		return;
+
+	BenchFacade * facade = BenchFacade::getInstance();
+	for (int i = 0; i < 10; ++i)
+	{
+		char name[32];
+		sprintf(name, "names%d", i);
+		facade->registerMediator(new NameMediator(name));
+	}
+	SendByName send = {facade, "application/state/changed"};
+	measure("sendNotification/longname/10", send, 100, 2000);
+}
+
+struct SendBatch
+{
+	void operator()(long)
+	{
+		facade->sendNotifications(batch);
+	}
+	BenchFacade * facade;
+	NotificationBatch batch;
+};
+
+struct SendEach
+{
+	void operator()(long)
+	{
+		for (size_t i = 0; i < batch.size(); ++i)
+		{
+			facade->sendNotification(*batch[i]);
+		}
+	}
+	BenchFacade * facade;
+	NotificationBatch batch;
+};
+
+// 1000 notifications over 10 names, each name observed by 10 mediators,
+// sent one by one and as a batch; one op is the whole 1000
+static void benchSendNotifications()
+{
+	if (!selected("sendNotifications"))
+		return;
+
+	BenchFacade * facade = BenchFacade::getInstance();
+	std::vector<Notification> notifications;
+	for (int n = 0; n < 10; ++n)
+	{
+		char interest[32];
+		sprintf(interest, "bench/batch%d", n);
+		for (int i = 0; i < 10; ++i)
+		{
+			char name[48];
+			sprintf(name, "%s/%d", interest, i);
+			facade->registerMediator(new BenchMediator(name, interest));
+		}
+		for (int i = 0; i < 100; ++i)
+		{
+			notifications.push_back(Notification(interest));
+		}
+	}
+	NotificationBatch batch;
+	for (size_t i = 0; i < notifications.size(); ++i)
+	{
+		batch.push_back(&notifications[(i * 7) % notifications.size()]);
+	}
+
+	SendEach each = {facade, batch};
+	measure("sendNotifications/each/1000", each, 100, 1);
+	SendBatch batched = {facade, batch};
+	measure("sendNotifications/batch/1000", batched, 100, 1);
+}
+
+struct MediatorChurn
+{
+	void operator()(long i)
+	{
+		const std::string & name = names[i % names.size()];
+		facade->registerMediator(new BenchMediator(name, "bench/churn"));
+		delete facade->removeMediator(name);
+	}
+	BenchFacade * facade;
+	std::vector<std::string> names;
+};
+
+// registerMediator immediately followed by removeMediator
+static void benchMediatorChurn()
+{
+	if (!selected("registerMediator"))
+		return;
+
+	MediatorChurn churn;
+	churn.facade = BenchFacade::getInstance();
+	for (int i = 0; i < 64; ++i)
+	{
+		char name[32];
+		sprintf(name, "churn%d", i);
+		churn.names.push_back(name);
+	}
+	measure("registerMediator+removeMediator", churn, 50, 200);
+}
+
+// Millions of register/remove cycles on a notification with 10 fixed
+// observers; churn cost, dispatch latency and live heap blocks must stay flat
+static void benchChurnStability()
+{
+	if (!selected("churn"))
+		return;
+
+	BenchFacade * facade = BenchFacade::getInstance();
+	for (int i = 0; i < 10; ++i)
+	{
+		char name[32];
+		sprintf(name, "stable%d", i);
+		facade->registerMediator(new BenchMediator(name, "bench/stable"));
+	}
+	NotificationId stable = NotificationIds::getInstance()->registerType("bench/stable");
+	const std::string churnName("churning");
+
+	printf("\n%-32s %10s %10s %10s %10s\n", "churn", "cycles", "churn", "dispatch", "live");
+	const long chunk = 250000;
+	for (int c = 1; c <= 8; ++c)
+	{
+		Clock::time_point start = Clock::now();
+		for (long i = 0; i < chunk; ++i)
+		{
+			facade->registerMediator(new BenchMediator(churnName, "bench/stable"));
+			delete facade->removeMediator(churnName);
+		}
+		double churnNs = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / chunk;
+
+		start = Clock::now();
+		for (long i = 0; i < 10000; ++i)
+		{
+			facade->sendNotification(stable);
+		}
+		double dispatchNs = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / 10000;
+
+		printf("%-32s %10ld %10.1f %10.1f %10ld\n", "churn/register+remove", chunk * c,
+		       churnNs, dispatchNs, (long)(s_allocations.load() - s_frees.load()));
+	}
+}
+
+struct ExecuteCommand
+{
+	void operator()(long)
+	{
+		controller->executeCommand(notification);
+	}
+	IController * controller;
+	Notification notification;
+};
+
+// Controller::executeCommand for a shared command, a 10 step chain, a
+// command class instantiated per notification and an async command
+static void benchExecuteCommand()
+{
+	if (!selected("executeCommand"))
+		return;
+
+	BenchFacade * facade = BenchFacade::getInstance();
+	facade->registerCommand("bench/command", new BenchCommand());
+
+	MacroCommand * chain = new MacroCommand();
+	for (int i = 0; i < 10; ++i)
+	{
+		chain->addSubCommand(new BenchCommand());
+	}
+	facade->registerCommand("bench/chain", chain);
+
+	ExecuteCommand single = {Controller::getInstance(), Notification("bench/command")};
+	measure("executeCommand", single, 100, 10000);
+
+	ExecuteCommand chained = {Controller::getInstance(), Notification("bench/chain")};
+	measure("executeCommand/chain/10", chained, 100, 5000);
+
+	facade->registerCommand<BenchCommand>("bench/factory");
+	ExecuteCommand pooled = {Controller::getInstance(), Notification("bench/factory")};
+	measure("executeCommand/factory", pooled, 100, 10000);
+
+	facade->registerAsyncCommand("bench/async", new SpinCommand(10));
+	ExecuteCommand async = {Controller::getInstance(), Notification("bench/async")};
+	measure("executeCommand/async", async, 100, 1000);
+	facade->flushCommands();
+}
+
+struct ExecuteMacro
+{
+	void operator()(long)
+	{
+		command->execute(notification);
+	}
+	ICommand * command;
+	Notification notification;
+};
+
+// 16 independent sub-commands of about 2us each, run in order by a
+// MacroCommand and in parallel by a ParallelMacroCommand
+static void benchMacroCommands()
+{
+	if (!selected("macro"))
+		return;
+
+	MacroCommand sequential;
+	ParallelMacroCommand parallel;
+	for (int i = 0; i < 16; ++i)
+	{
+		SpinCommand * spin = new SpinCommand(2000);
+		sequential.addSubCommand(spin);
+		parallel.addSubCommand(spin);
+	}
+	ExecuteMacro runSequential = {&sequential, Notification("bench/macro")};
+	measure("macro/sequential/wide16", runSequential, 50, 20);
+	ExecuteMacro runParallel = {&parallel, Notification("bench/macro")};
+	measure("macro/parallel/wide16", runParallel, 50, 20);
+	printf("%-32s %10u\n", "macro/workers", (unsigned)WorkStealingPool::getInstance()->size());
+}
+
+struct RetrieveProxy
+{
+	void operator()(long i)
+	{
+		found += facade->retrieveProxy(names[(i * 7919) % names.size()]) != NULL;
+	}
+	BenchFacade * facade;
+	std::vector<std::string> names;
+	long found;
+};
+
+struct RetrieveProxyHandle
+{
+	void operator()(long i)
+	{
+		found += facade->retrieveProxy<Proxy>(handles[(i * 7919) % handles.size()]) != NULL;
+	}
+	BenchFacade * facade;
+	std::vector<ProxyHandle> handles;
+	long found;
+};
+
+// Model::retrieveProxy by name and by handle with 10 and 100000
+// registered proxies
+static void benchRetrieveProxy()
+{
+	if (!selected("retrieveProxy"))
+		return;
+
+	BenchFacade * facade = BenchFacade::getInstance();
+	const int counts[] = {10, 100000};
+	int registered = 0;
+	for (size_t c = 0; c < sizeof(counts) / sizeof(counts[0]); ++c)
+	{
+		RetrieveProxy retrieve;
+		retrieve.facade = facade;
+		retrieve.found = 0;
+		for (int i = 0; i < counts[c]; ++i)
+		{
+			char name[48];
+			sprintf(name, "application/proxy/%d", i);
+			retrieve.names.push_back(name);
+			if (i >= registered)
+			{
+				facade->registerProxy(new Proxy(name));
+			}
+		}
+		registered = counts[c];
+
+		char label[64];
+		sprintf(label, "retrieveProxy/%d", counts[c]);
+		measure(label, retrieve, 100, 10000);
+		if (retrieve.found != 101 * 10000)
+			printf("%s: lookup mismatch\n", label);
+
+		RetrieveProxyHandle byHandle;
+		byHandle.facade = facade;
+		byHandle.found = 0;
+		for (size_t i = 0; i < retrieve.names.size(); ++i)
+		{
+			byHandle.handles.push_back(facade->getProxyHandle(retrieve.names[i]));
+		}
+		sprintf(label, "retrieveProxy/handle/%d", counts[c]);
+		measure(label, byHandle, 100, 10000);
+		if (byHandle.found != 101 * 10000)
+			printf("%s: lookup mismatch\n", label);
+	}
+}
+
+struct Quote
+{
+	Quote() : bid(0), ask(0) {}
+	double bid;
+	double ask;
+};
+
+struct ReadQuote
+{
+	void operator()(long)
+	{
+		VersionedProxy<Quote>::Reader reader(*proxy);
+		sum += reader->bid;
+	}
+	VersionedProxy<Quote> * proxy;
+	double sum;
+};
+
+struct SkipUnchanged
+{
+	void operator()(long)
+	{
+		changed += proxy->readIfChanged(seen, quote);
+	}
+	VersionedProxy<Quote> * proxy;
+	uint64_t seen;
+	Quote quote;
+	long changed;
+};
+
+struct PublishQuote
+{
+	void operator()(long i)
+	{
+		quote.bid = double(i);
+		proxy->publish(quote);
+	}
+	VersionedProxy<Quote> * proxy;
+	Quote quote;
+};
+
+// VersionedProxy snapshot reads, skipped unchanged reads and publishes,
+// the last with and without a change notification to 10 mediators
+static void benchVersionedProxy()
+{
+	if (!selected("versioned"))
+		return;
+
+	BenchFacade * facade = BenchFacade::getInstance();
+	for (int i = 0; i < 10; ++i)
+	{
+		char name[48];
+		sprintf(name, "bench/versioned/%d", i);
+		facade->registerMediator(new BenchMediator(name, "bench/versioned"));
+	}
+	VersionedProxy<Quote> * proxy = new VersionedProxy<Quote>("bench/versioned");
+
+	ReadQuote read = {proxy, 0};
+	measure("versioned/read", read, 100, 100000);
+	SkipUnchanged skip = {proxy, proxy->getVersion(), Quote(), 0};
+	measure("versioned/readIfChanged/same", skip, 100, 100000);
+	PublishQuote publish = {proxy, Quote()};
+	measure("versioned/publish", publish, 100, 10000);
+	proxy->setChangeNotification(facade, "bench/versioned");
+	measure("versioned/publish+notify10", publish, 100, 10000);
+	proxy->setChangeNotification(NULL);
+}
+
+// The baseline for benchExecutorScaling: one queue under one mutex
+// shared by every worker
+class SharedQueuePool
+{
+public:
+	typedef void (*TaskFunction)(void *);
+
+	explicit SharedQueuePool(size_t threads) : m_running(true)
+	{
+		for (size_t i = 0; i < threads; ++i)
+			m_workers.push_back(std::thread(&SharedQueuePool::run, this));
+	}
+
+	~SharedQueuePool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_running = false;
+		}
+		m_ready.notify_all();
+		for (size_t i = 0; i < m_workers.size(); ++i)
+			m_workers[i].join();
+	}
+
+	void submit(TaskFunction function, void * argument)
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_tasks.push_back(std::make_pair(function, argument));
+		}
+		m_ready.notify_one();
+	}
+
+private:
+	void run()
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		for (;;)
+		{
+			while (m_tasks.empty() && m_running)
+				m_ready.wait(lock);
+			if (m_tasks.empty())
+				return;
+			std::pair<TaskFunction, void *> task = m_tasks.front();
+			m_tasks.pop_front();
+			lock.unlock();
+			task.first(task.second);
+			lock.lock();
+		}
+	}
+
+	std::mutex m_mutex;
+	std::condition_variable m_ready;
+	std::deque<std::pair<TaskFunction, void *> > m_tasks;
+	std::vector<std::thread> m_workers;
+	bool m_running;
+};
+
+// A batch of tasks: leaves burn a little CPU, roots submit children
+template <class Pool>
+struct TaskBatch
+{
+	static void leaf(void * argument)
+	{
+		TaskBatch * batch = static_cast<TaskBatch *>(argument);
+		unsigned long x = 1;
+		for (int i = 0; i < 100; ++i)
+			x = x * 6364136223846793005UL + 1442695040888963407UL;
+		batch->sink.fetch_add(x & 1, std::memory_order_relaxed);
+		batch->remaining.fetch_sub(1);
+	}
+
+	static void root(void * argument)
+	{
+		TaskBatch * batch = static_cast<TaskBatch *>(argument);
+		for (int i = 0; i < batch->fanout; ++i)
+			batch->pool->submit(&TaskBatch::leaf, batch);
+		batch->remaining.fetch_sub(1);
+	}
+
+	// roots tasks each submitting fanout leaves from inside the pool,
+	// or roots leaves submitted from outside when fanout is 0
+	double run(int roots)
+	{
+		remaining.store(fanout == 0 ? roots : roots * (fanout + 1));
+		Clock::time_point start = Clock::now();
+		for (int i = 0; i < roots; ++i)
+			pool->submit(fanout == 0 ? &TaskBatch::leaf : &TaskBatch::root, this);
+		while (remaining.load() != 0)
+			std::this_thread::yield();
+		return std::chrono::duration<double>(Clock::now() - start).count();
+	}
+
+	Pool * pool;
+	int fanout;
+	std::atomic<long> remaining;
+	std::atomic<unsigned long> sink;
+};
+
+template <class Pool>
+static void executorRow(const char * label, Pool * pool, unsigned threads, int roots, int fanout)
+{
+	TaskBatch<Pool> batch;
+	batch.pool = pool;
+	batch.fanout = fanout;
+	batch.sink.store(0);
+	batch.run(roots / 10);
+	double seconds = batch.run(roots);
+	double tasks = fanout == 0 ? roots : double(roots) * (fanout + 1);
+	printf("%-32s %10u %10.0f %10.1f\n", label, threads, tasks / seconds, seconds * 1e9 / tasks);
+}
+
+// Task throughput of the WorkStealingPool against one shared queue,
+// for tasks submitted from outside and fanned out from inside the pool
+static void benchExecutorScaling()
+{
+	if (!selected("executor"))
+		return;
+
+	unsigned cores = std::thread::hardware_concurrency();
+	if (cores == 0)
+		cores = 1;
+
+	printf("\n%-32s %10s %10s %10s\n", "executor", "threads", "tasks/s", "ns/task");
+	for (unsigned threads = 1; threads <= cores; threads *= 2)
+	{
+		WorkStealingPool stealing(threads);
+		executorRow("executor/stealing/external", &stealing, threads, 100000, 0);
+		executorRow("executor/stealing/fanout100", &stealing, threads, 1000, 100);
+		SharedQueuePool shared(threads);
+		executorRow("executor/shared/external", &shared, threads, 100000, 0);
+		executorRow("executor/shared/fanout100", &shared, threads, 1000, 100);
+	}
+
+}
+
+static void lookupLoop(const std::vector<std::string> * names, const std::vector<ProxyHandle> * handles,
+                       long rounds, std::atomic<long> * found)
+{
+	BenchFacade * facade = BenchFacade::getInstance();
+	long hits = 0;
+	for (long i = 0; i < rounds; ++i)
+	{
+		size_t k = (size_t)(i * 7919) % names->size();
+		if (handles != NULL)
+			hits += facade->retrieveProxy((*handles)[k]) != NULL;
+		else
+			hits += facade->retrieveProxy((*names)[k]) != NULL;
+	}
+	found->fetch_add(hits);
+}
+
+static void churnLoop(Proxy * proxy, std::atomic<bool> * stop)
+{
+	BenchFacade * facade = BenchFacade::getInstance();
+	while (!stop->load())
+	{
+		facade->registerProxy(proxy);
+		facade->removeProxy(proxy->getName());
+		std::this_thread::yield();
+	}
+}
+
+// Concurrent proxy lookups by name and by handle, with and without a
+// thread registering and removing another proxy meanwhile
+static void benchProxyScaling()
+{
+	if (!selected("proxyscaling"))
+		return;
+
+	BenchFacade * facade = BenchFacade::getInstance();
+	std::vector<std::string> names;
+	std::vector<ProxyHandle> handles;
+	for (int i = 0; i < 1000; ++i)
+	{
+		char name[48];
+		sprintf(name, "bench/scaling/proxy/%d", i);
+		names.push_back(name);
+		facade->registerProxy(new Proxy(name));
+		handles.push_back(facade->getProxyHandle(name));
+	}
+	Proxy * churned = new Proxy("bench/scaling/churn");
+
+	unsigned cores = std::thread::hardware_concurrency();
+	if (cores == 0)
+		cores = 1;
+	const long rounds = 1000000;
+
+	printf("\n%-32s %10s %10s %10s\n", "proxyscaling", "threads", "lookups/s", "ns/op");
+	for (int mode = 0; mode < 4; ++mode)
+	{
+		bool byHandle = (mode & 1) != 0;
+		bool writer = (mode & 2) != 0;
+		for (unsigned threads = 1; threads <= cores; threads *= 2)
+		{
+			std::atomic<long> found(0);
+			std::atomic<bool> stop(false);
+			std::thread churn;
+			if (writer)
+			{
+				churn = std::thread(churnLoop, churned, &stop);
+			}
+			Clock::time_point start = Clock::now();
+			std::vector<std::thread> workers;
+			for (unsigned t = 0; t < threads; ++t)
+			{
+				workers.push_back(std::thread(lookupLoop, &names, byHandle ? &handles : NULL, rounds, &found));
+			}
+			for (size_t t = 0; t < workers.size(); ++t)
+			{
+				workers[t].join();
+			}
+			double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+			stop.store(true);
+			if (churn.joinable())
+				churn.join();
+			double total = double(rounds) * threads;
+			const char * labels[] = {"proxyscaling/name", "proxyscaling/handle",
+			                         "proxyscaling/name+writer", "proxyscaling/handle+writer"};
+			printf("%-32s %10u %10.0f %10.1f\n", labels[mode],
+			       threads, total / seconds, seconds * 1e9 / rounds);
+			if (found.load() != (long)total)
+				printf("%s: lookup mismatch\n", labels[mode]);
+		}
+	}
+}
+
+static void sendLoop(NotificationId id, long rounds)
+{
+	BenchFacade * facade = BenchFacade::getInstance();
+	for (long i = 0; i < rounds; ++i)
+	{
+		facade->sendNotification(id);
+	}
+}
+
+// sendNotification throughput with 10 observers as sender threads are added
+static void benchThreadScaling()
+{
+	if (!selected("scaling"))
+		return;
+
+	BenchFacade * facade = BenchFacade::getInstance();
+	for (int i = 0; i < 10; ++i)
+	{
+		char name[32];
+		sprintf(name, "scaling%d", i);
+		facade->registerMediator(new BenchMediator(name, "bench/scaling"));
+	}
+	NotificationId bench = NotificationIds::getInstance()->registerType("bench/scaling");
+
+	unsigned cores = std::thread::hardware_concurrency();
+	if (cores == 0)
+		cores = 1;
+	const long rounds = 200000;
+
+	printf("\n%-32s %10s %10s %10s\n", "scaling", "threads", "notes/s", "ns/op");
+	for (unsigned threads = 1; threads <= cores; threads *= 2)
+	{
+		Clock::time_point start = Clock::now();
+		std::vector<std::thread> workers;
+		for (unsigned t = 0; t < threads; ++t)
+		{
+			workers.push_back(std::thread(sendLoop, bench, rounds));
+		}
+		for (size_t t = 0; t < workers.size(); ++t)
+		{
+			workers[t].join();
+		}
+		double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+		double total = double(rounds) * threads;
+		printf("%-32s %10u %10.0f %10.1f\n", "scaling/10obs",
+		       threads, total / seconds, seconds * 1e9 / rounds);
+	}
+}
+
+static void shardLoop(BenchFacade * facade, NotificationId id, long rounds)
+{
+	for (long i = 0; i < rounds; ++i)
+	{
+		facade->sendNotification(id);
+	}
+}
+
+// The same load with every sender thread on its own Multiton core
+static void benchShardScaling()
+{
+	if (!selected("shards"))
+		return;
+
+	NotificationId bench = NotificationIds::getInstance()->registerType("bench/shard");
+	unsigned cores = std::thread::hardware_concurrency();
+	if (cores == 0)
+		cores = 1;
+	const long rounds = 200000;
+
+	std::vector<BenchFacade *> shards;
+	for (unsigned s = 0; s < cores; ++s)
+	{
+		char key[32];
+		sprintf(key, "shard%u", s);
+		BenchFacade * shard = BenchFacade::getInstance(key);
+		for (int i = 0; i < 10; ++i)
+		{
+			char name[32];
+			sprintf(name, "shard%u/%d", s, i);
+			shard->registerMediator(new BenchMediator(name, "bench/shard"));
+		}
+		shards.push_back(shard);
+	}
+
+	printf("\n%-32s %10s %10s %10s\n", "shards", "threads", "notes/s", "ns/op");
+	for (unsigned threads = 1; threads <= cores; threads *= 2)
+	{
+		Clock::time_point start = Clock::now();
+		std::vector<std::thread> workers;
+		for (unsigned t = 0; t < threads; ++t)
+		{
+			workers.push_back(std::thread(shardLoop, shards[t], bench, rounds));
+		}
+		for (size_t t = 0; t < workers.size(); ++t)
+		{
+			workers[t].join();
+		}
+		double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+		double total = double(rounds) * threads;
+		printf("%-32s %10u %10.0f %10.1f\n", "shards/10obs",
+		       threads, total / seconds, seconds * 1e9 / rounds);
+	}
+}
+
+// Answers a burst request by sending that many notifications over the bus
+class BurstMediator : public Mediator
+{
+public:
+	BurstMediator(NotificationId target) : Mediator("burst"), m_target(target) {}
+
+	virtual Interests listNotificationInterests()
+	{
+		Interests interests;
+		interests.push_back("bench/burst");
+		return interests;
+	}
+
+	virtual void handleNotification(const INotification & notification)
+	{
+		long count = (long)const_cast<INotification &>(notification).getBody();
+		ShardBus * bus = ShardBus::current();
+		for (long i = 0; i < count; ++i)
+		{
+			bus->sendNotification(Notification(m_target));
+		}
+	}
+	NotificationId m_target;
+};
+
+struct ShardBurst
+{
+	ShardBus * bus;
+	long count;
+	void operator()(long)
+	{
+		bus->sendNotification(Notification("bench/burst", (void *)count));
+		bus->flush();
+	}
+};
+
+// One shard sending to a mediator on another, through the SPSC ring
+static void benchShardBus()
+{
+	if (!selected("shardbus"))
+		return;
+
+	NotificationId cross = NotificationIds::getInstance()->registerType("bench/cross");
+	BurstMediator * burst = new BurstMediator(cross);
+	BenchMediator * receiver = new BenchMediator("crossReceiver", "bench/cross");
+	ShardBus * bus = new ShardBus("benchbus", 2);
+	bus->getView(0)->registerMediator(burst);
+	bus->getView(1)->registerMediator(receiver);
+
+	ShardBurst op = { bus, 1000 };
+	measure("shardbus/burst1000", op, 200, 1);
+
+	delete bus;
+}
+
+typedef boost::function<void (const INotification &)> BoostNotifyMethod;
+
+template <class Method>
+struct InvokeMethod
+{
+	void operator()(long)
+	{
+		method(notification);
+	}
+	Method method;
+	Notification notification;
+};
+
+struct BindNotifyMethod
+{
+	void operator()(long i)
+	{
+		methods[i % 64] = NotifyMethod::bind<IMediator, &IMediator::handleNotification>(mediator);
+	}
+	IMediator * mediator;
+	std::vector<NotifyMethod> methods;
+};
+
+struct BindBoostNotifyMethod
+{
+	void operator()(long i)
+	{
+		methods[i % 64] = boost::bind(&IMediator::handleNotification, mediator, boost::placeholders::_1);
+	}
+	IMediator * mediator;
+	std::vector<BoostNotifyMethod> methods;
+};
+
+// Building and calling an observer callback, NotifyMethod against
+// boost::function; the handler is empty so only the call is measured
+static void benchNotifyMethod()
+{
+	if (!selected("NotifyMethod"))
+		return;
+
+	IMediator * mediator = new Mediator("notifyMethod");
+	Notification notification("bench/notifyMethod");
+
+	InvokeMethod<NotifyMethod> invoke = {
+		NotifyMethod::bind<IMediator, &IMediator::handleNotification>(mediator), notification};
+	measure("NotifyMethod/invoke", invoke, 100, 100000);
+	InvokeMethod<BoostNotifyMethod> invokeBoost = {
+		boost::bind(&IMediator::handleNotification, mediator, boost::placeholders::_1), notification};
+	measure("NotifyMethod/boost/invoke", invokeBoost, 100, 100000);
+
+	BindNotifyMethod bind = {mediator, std::vector<NotifyMethod>(64)};
+	measure("NotifyMethod/bind", bind, 100, 100000);
+	BindBoostNotifyMethod bindBoost = {mediator, std::vector<BoostNotifyMethod>(64)};
+	measure("NotifyMethod/boost/bind", bindBoost, 100, 100000);
+}
+
+struct StringHash
+{
+	size_t operator()(const std::string & data) const
+	{
+		return hashString(data);
+	}
+};
+
+typedef FlatHashMap<std::string, void *, StringHash> FlatMap;
+typedef __gnu_cxx::hash_map<std::string, void *, StringHash> GnuMap;
+typedef std::unordered_map<std::string, void *, StringHash> StdMap;
+
+// Insert and lookup throughput of a map keyed by mediator-like names
+template <class Map>
+static void benchMap(const char * label, const std::vector<std::string> & keys)
+{
+	const int rounds = 20;
+	Clock::time_point start = Clock::now();
+	for (int r = 0; r < rounds; ++r)
+	{
+		Map map;
+		for (size_t i = 0; i < keys.size(); ++i)
+		{
+			map[keys[i]] = (void *)&keys[i];
+		}
+	}
+	double insertSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+	Map map;
+	for (size_t i = 0; i < keys.size(); ++i)
+	{
+		map[keys[i]] = (void *)&keys[i];
+	}
+	size_t found = 0;
+	start = Clock::now();
+	for (int r = 0; r < rounds; ++r)
+	{
+		for (size_t i = 0; i < keys.size(); ++i)
+		{
+			found += map.find(keys[(i * 7919) % keys.size()]) != map.end();
+		}
+	}
+	double findSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+	if (found != keys.size() * rounds)
+		printf("%s: lookup mismatch\n", label);
+
+	double ops = double(keys.size()) * rounds;
+	printf("%-32s %10zu %10.1f %10.1f\n", label, keys.size(),
+	       insertSeconds * 1e9 / ops, findSeconds * 1e9 / ops);
+}
+
+static void benchMaps()
+{
+	if (!selected("map"))
+		return;
+
+	printf("\n%-32s %10s %10s %10s\n", "map", "keys", "insert", "find");
+	for (size_t count = 16; count <= 16384; count *= 32)
+	{
+		std::vector<std::string> keys;
+		for (size_t i = 0; i < count; ++i)
+		{
+			char name[48];
+			sprintf(name, "application/mediator/%zu", i);
+			keys.push_back(name);
+		}
+		benchMap<FlatMap>("map/FlatHashMap", keys);
+		benchMap<GnuMap>("map/__gnu_cxx::hash_map", keys);
+		benchMap<StdMap>("map/std::unordered_map", keys);
+	}
+}
+
+int main(int argc, char * argv[])
+{
+	if (argc > 1)
+		s_filter = argv[1];
+
+	printHeader();
+	benchSendNotification();
+	benchNameAllocations();
+	benchStopPropagation();
+	benchCoalescing();
+	benchTimers();
+	benchSendNotifications();
+	benchMediatorChurn();
+	benchExecuteCommand();
+	benchMacroCommands();
+	benchExecutorScaling();
+	benchRetrieveProxy();
+	benchProxyScaling();
+	benchVersionedProxy();
+	benchNotifyMethod();
+	benchThreadScaling();
+	benchShardScaling();
+	benchShardBus();
+	benchChurnStability();
+	benchMaps();
+	return 0;
+}
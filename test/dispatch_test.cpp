@@ -0,0 +1,1971 @@
+#include "utils/hash_func.hpp"
+#include "../interfaces/inotification.hpp"
+#include "../interfaces/imediator.hpp"
+#include "../interfaces/ifacade.hpp"
+#include "../interfaces/icontroller.hpp"
+#include "../core/view.hpp"
+#include "../core/model.hpp"
+#include "../core/controller.hpp"
+#include "../patterns/facade/facade.hpp"
+#include "../patterns/command/simple_command.hpp"
+#include "../patterns/command/macro_command.hpp"
+#include "../patterns/command/parallel_macro_command.hpp"
+#include "../patterns/proxy/proxy.hpp"
+#include "../patterns/proxy/versioned_proxy.hpp"
+#include "../patterns/observer/shard_bus.hpp"
+
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <new>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+// Count every heap allocation made by the process, and every free
+static std::atomic<size_t> s_allocations(0);
+static std::atomic<size_t> s_frees(0);
+
+// Kept out of line: once inlined, GCC sees free() called on memory from
+// operator new and warns with -Wmismatched-new-delete
+#if defined(__GNUC__)
+#define COUNTED_ALLOC __attribute__((noinline))
+#else
+#define COUNTED_ALLOC
+#endif
+
+COUNTED_ALLOC void * operator new(size_t size)
+{
+	++s_allocations;
+	void * p = malloc(size ? size : 1);
+	if (p == NULL)
+		throw std::bad_alloc();
+	return p;
+}
+
+COUNTED_ALLOC void operator delete(void * p) throw()
+{
+	if (p != NULL)
+		++s_frees;
+	free(p);
+}
+
+COUNTED_ALLOC void operator delete(void * p, size_t) throw()
+{
+	if (p != NULL)
+		++s_frees;
+	free(p);
+}
+
+COUNTED_ALLOC void * operator new[](size_t size)
+{
+	return operator new(size);
+}
+
+COUNTED_ALLOC void operator delete[](void * p) throw()
+{
+	operator delete(p);
+}
+
+COUNTED_ALLOC void operator delete[](void * p, size_t) throw()
+{
+	operator delete(p);
+}
+
+static int s_failures = 0;
+
+#define CHECK(cond)                                                      \
+	do {                                                                 \
+		if (!(cond)) {                                                   \
+			std::cout << __FILE__ << ":" << __LINE__ << ": CHECK failed: " \
+			          << #cond << std::endl;                             \
+			++s_failures;                                                \
+		}                                                                \
+	} while (0)
+
+class TestFacade : public Facade<TestFacade>
+{
+public:
+	TestFacade() {}
+	TestFacade(const std::string & key) : Facade<TestFacade>(key) {}
+};
+
+class CountingCommand : public SimpleCommand
+{
+public:
+	CountingCommand() : m_count(0) {}
+	virtual void execute(const INotification & notification)
+	{
+		++m_count;
+	}
+	int m_count;
+};
+
+class CountingMediator : public Mediator
+{
+public:
+	CountingMediator(const std::string & name) : Mediator(name), m_count(0) {}
+
+	virtual Interests listNotificationInterests()
+	{
+		Interests interests;
+		interests.push_back("tick");
+		return interests;
+	}
+
+	virtual void handleNotification(const INotification & notification)
+	{
+		++m_count;
+	}
+	int m_count;
+};
+
+// Registers another mediator for the notification being dispatched
+class RegisteringMediator : public CountingMediator
+{
+public:
+	RegisteringMediator(CountingMediator * late)
+		: CountingMediator("registering"), m_late(late) {}
+
+	virtual void handleNotification(const INotification & notification)
+	{
+		CountingMediator::handleNotification(notification);
+		if (m_late != NULL)
+		{
+			TestFacade::getInstance()->registerMediator(m_late);
+			m_late = NULL;
+		}
+	}
+	CountingMediator * m_late;
+};
+
+static void testZeroAllocationDispatch()
+{
+	TestFacade * facade = TestFacade::getInstance();
+
+	CountingMediator * mediators[10];
+	for (int i = 0; i < 10; ++i)
+	{
+		mediators[i] = new CountingMediator(std::string("m") + char('0' + i));
+		facade->registerMediator(mediators[i]);
+	}
+	CountingCommand * command = new CountingCommand();
+	facade->registerCommand("tick", command);
+
+	NotificationId tick = NotificationIds::getInstance()->registerType("tick");
+	Notification note("tick");
+
+	// warm up
+	facade->sendNotification(tick);
+	facade->sendNotification(note);
+
+	const int rounds = 1000;
+	size_t before = s_allocations;
+	for (int i = 0; i < rounds; ++i)
+	{
+		facade->sendNotification(tick);
+		facade->sendNotification(note);
+	}
+	size_t allocations = s_allocations - before;
+
+	std::cout << "allocations per sendNotification: "
+	          << double(allocations) / (2 * rounds) << std::endl;
+	CHECK(allocations == 0);
+	CHECK(command->m_count == 2 * rounds + 2);
+	for (int i = 0; i < 10; ++i)
+	{
+		CHECK(mediators[i]->m_count == 2 * rounds + 2);
+	}
+}
+
+static void testRegisterDuringDispatch()
+{
+	TestFacade * facade = TestFacade::getInstance();
+
+	CountingMediator * late = new CountingMediator("late");
+	RegisteringMediator * registering = new RegisteringMediator(late);
+	facade->registerMediator(registering);
+
+	// the late mediator joins during this dispatch but only sees the next one
+	facade->sendNotification("tick");
+	CHECK(registering->m_count == 1);
+	CHECK(late->m_count == 0);
+	CHECK(facade->hasMediator("late"));
+
+	facade->sendNotification("tick");
+	CHECK(registering->m_count == 2);
+	CHECK(late->m_count == 1);
+}
+
+class StressMediator : public Mediator
+{
+public:
+	StressMediator(const std::string & name) : Mediator(name), m_count(0) {}
+
+	virtual Interests listNotificationInterests()
+	{
+		Interests interests;
+		interests.push_back("stress");
+		return interests;
+	}
+
+	virtual void handleNotification(const INotification & notification)
+	{
+		m_count.fetch_add(1);
+	}
+	std::atomic<int> m_count;
+};
+
+static void sendStress(int rounds)
+{
+	TestFacade * facade = TestFacade::getInstance();
+	NotificationId stress = NotificationIds::getInstance()->registerType("stress");
+	for (int i = 0; i < rounds; ++i)
+	{
+		if (i & 1)
+			facade->sendNotification(stress);
+		else
+			facade->sendNotification("stress");
+	}
+}
+
+static void registerStress(std::vector<StressMediator *> * late)
+{
+	TestFacade * facade = TestFacade::getInstance();
+	for (size_t i = 0; i < late->size(); ++i)
+	{
+		facade->registerMediator((*late)[i]);
+		facade->registerCommand("stress", new SimpleCommand());
+	}
+}
+
+// Senders on several threads while another thread keeps registering
+static void testConcurrentDispatch()
+{
+	TestFacade * facade = TestFacade::getInstance();
+	const int senders = 4;
+	const int rounds = 20000;
+
+	std::vector<StressMediator *> fixed;
+	for (int i = 0; i < 4; ++i)
+	{
+		fixed.push_back(new StressMediator(std::string("fixed") + char('0' + i)));
+		facade->registerMediator(fixed.back());
+	}
+	std::vector<StressMediator *> late;
+	for (int i = 0; i < 200; ++i)
+	{
+		late.push_back(new StressMediator(std::string("late") + char('A' + i / 26) + char('a' + i % 26)));
+	}
+
+	std::vector<std::thread> threads;
+	for (int i = 0; i < senders; ++i)
+	{
+		threads.push_back(std::thread(sendStress, rounds));
+	}
+	threads.push_back(std::thread(registerStress, &late));
+	for (size_t i = 0; i < threads.size(); ++i)
+	{
+		threads[i].join();
+	}
+
+	for (size_t i = 0; i < fixed.size(); ++i)
+	{
+		CHECK(fixed[i]->m_count.load() == senders * rounds);
+	}
+	for (size_t i = 0; i < late.size(); ++i)
+	{
+		CHECK(late[i]->m_count.load() <= senders * rounds);
+		CHECK(facade->hasMediator(late[i]->getName()));
+	}
+	CHECK(facade->hasCommand("stress"));
+}
+
+// Records the sequence numbers it receives, one list per notification name
+class SequenceMediator : public Mediator
+{
+public:
+	SequenceMediator() : Mediator("sequence"), m_blocked(false), m_gated(false) {}
+
+	virtual Interests listNotificationInterests()
+	{
+		Interests interests;
+		interests.push_back("seqA");
+		interests.push_back("seqB");
+		interests.push_back("gate");
+		return interests;
+	}
+
+	virtual void handleNotification(const INotification & notification)
+	{
+		const std::string & name = notification.getName();
+		if (name == "gate")
+		{
+			m_gated.store(true);
+			while (m_blocked.load())
+				std::this_thread::yield();
+			return;
+		}
+		long seq = (long)const_cast<INotification &>(notification).getBody();
+		if (name == "seqA")
+			m_a.push_back(seq);
+		else
+			m_b.push_back(seq);
+	}
+
+	std::vector<long> m_a;
+	std::vector<long> m_b;
+	std::atomic<bool> m_blocked;
+	std::atomic<bool> m_gated;
+};
+
+static bool isSequence(const std::vector<long> & seq, long count)
+{
+	if ((long)seq.size() != count)
+		return false;
+	for (long i = 0; i < count; ++i)
+	{
+		if (seq[i] != i)
+			return false;
+	}
+	return true;
+}
+
+static void postStress(int rounds)
+{
+	TestFacade * facade = TestFacade::getInstance();
+	for (int i = 0; i < rounds; ++i)
+		facade->postNotification("stress");
+}
+
+// Throws from every "post/throw" it gets
+class ThrowingMediator : public Mediator
+{
+public:
+	ThrowingMediator() : Mediator("throwing") {}
+
+	virtual Interests listNotificationInterests()
+	{
+		Interests interests;
+		interests.push_back("post/throw");
+		return interests;
+	}
+
+	virtual void handleNotification(const INotification & notification)
+	{
+		throw std::runtime_error("observer failed");
+	}
+};
+
+static bool flushNotificationsThrows(TestFacade * facade)
+{
+	try
+	{
+		facade->flushNotifications();
+	}
+	catch (const std::runtime_error &)
+	{
+		return true;
+	}
+	return false;
+}
+
+static void testAsyncDispatch()
+{
+	TestFacade * facade = TestFacade::getInstance();
+	SequenceMediator * mediator = new SequenceMediator();
+	facade->registerMediator(mediator);
+
+	// per-name ordering across three workers
+	facade->startAsyncDispatch(3, 16, AsyncDispatcher::BLOCK);
+	const long count = 5000;
+	for (long i = 0; i < count; ++i)
+	{
+		CHECK(facade->postNotification("seqA", (void *)i));
+		CHECK(facade->postNotification("seqB", (void *)i));
+	}
+	facade->flushNotifications();
+	CHECK(isSequence(mediator->m_a, count));
+	CHECK(isSequence(mediator->m_b, count));
+
+	// a full queue drops under the DROP policy; one worker, so "gate"
+	// holds up everything queued behind it
+	facade->startAsyncDispatch(1, 4, AsyncDispatcher::DROP);
+	mediator->m_a.clear();
+	mediator->m_blocked.store(true);
+	CHECK(facade->postNotification("gate"));
+	while (!mediator->m_gated.load())
+		std::this_thread::yield();
+	int accepted = 0;
+	for (long i = 0; i < 100; ++i)
+	{
+		if (facade->postNotification("seqA", (void *)i))
+			++accepted;
+	}
+	CHECK(accepted <= 4);
+	mediator->m_blocked.store(false);
+	facade->stopAsyncDispatch();
+	CHECK(isSequence(mediator->m_a, accepted));
+
+	// without workers postNotification is synchronous
+	mediator->m_a.clear();
+	CHECK(facade->postNotification("seqA", (void *)0));
+	CHECK(mediator->m_a.size() == 1);
+
+	// posts racing with start and stop are each delivered once
+	StressMediator * posted = new StressMediator("posted");
+	facade->registerMediator(posted);
+	const int posters = 3;
+	const int rounds = 2000;
+	std::vector<std::thread> threads;
+	for (int i = 0; i < posters; ++i)
+		threads.push_back(std::thread(postStress, rounds));
+	for (int i = 0; i < 20; ++i)
+	{
+		facade->startAsyncDispatch(2, 16, AsyncDispatcher::BLOCK);
+		std::this_thread::yield();
+		facade->stopAsyncDispatch();
+	}
+	for (size_t i = 0; i < threads.size(); ++i)
+		threads[i].join();
+	facade->stopAsyncDispatch();
+	CHECK(posted->m_count.load() == posters * rounds);
+	facade->removeMediator("posted");
+
+	// a throwing observer neither kills the worker nor hangs the flush;
+	// the flush reports it, once
+	ThrowingMediator throwing;
+	facade->registerMediator(&throwing);
+	facade->startAsyncDispatch(1, 16, AsyncDispatcher::BLOCK);
+	mediator->m_a.clear();
+	CHECK(facade->postNotification("post/throw"));
+	CHECK(facade->postNotification("post/throw"));
+	CHECK(facade->postNotification("seqA", (void *)0));
+	CHECK(flushNotificationsThrows(facade));
+	CHECK(!flushNotificationsThrows(facade));
+	CHECK(mediator->m_a.size() == 1);
+	facade->stopAsyncDispatch();
+	facade->removeMediator("throwing");
+}
+
+struct Position
+{
+	Position(int x_, int y_) : x(x_), y(y_) {}
+	int x;
+	int y;
+};
+
+class PositionMediator : public Mediator
+{
+public:
+	PositionMediator() : Mediator("position"), m_sum(0), m_untyped(0) {}
+
+	virtual Interests listNotificationInterests()
+	{
+		Interests interests;
+		interests.push_back("moved");
+		return interests;
+	}
+
+	virtual void handleNotification(const INotification & notification)
+	{
+		const Position * pos = notification_cast<Position>(notification);
+		if (pos != NULL)
+			m_sum += pos->x + pos->y;
+		else if (notification_cast<int>(notification) == NULL)
+			++m_untyped;
+	}
+	long m_sum;
+	int m_untyped;
+};
+
+static void testTypedNotification()
+{
+	TestFacade * facade = TestFacade::getInstance();
+	PositionMediator * mediator = new PositionMediator();
+	facade->registerMediator(mediator);
+	NotificationId moved = NotificationIds::getInstance()->registerType("moved");
+
+	facade->sendTypedNotification(moved, Position(1, 2));
+	facade->sendTypedNotification("moved", Position(3, 4));
+	facade->sendNotification("moved");
+	CHECK(mediator->m_sum == 10);
+	CHECK(mediator->m_untyped == 1);
+
+	TypedNotification<Position> note(moved, Position(5, 6));
+	CHECK(note.getBody() == &note.getTypedBody());
+	CHECK(note.getName() == "moved");
+
+	size_t before = s_allocations;
+	for (int i = 0; i < 100; ++i)
+	{
+		facade->sendTypedNotification(moved, Position(i, 0));
+	}
+	CHECK(s_allocations == before);
+	CHECK(mediator->m_sum == 10 + 99 * 100 / 2);
+}
+
+class EarlyMediator : public CountingMediator
+{
+public:
+	EarlyMediator() : CountingMediator("early") {}
+
+	virtual Interests listNotificationInterests()
+	{
+		Interests interests;
+		interests.push_back("early/bird");
+		return interests;
+	}
+};
+
+// A notification built before anyone registered for its name has no id
+// and is resolved by its precomputed hash at dispatch time
+static void testResolveByHash()
+{
+	TestFacade * facade = TestFacade::getInstance();
+	Notification early("early/bird");
+	CHECK(early.getId() == 0);
+	CHECK(early.getNameHash() == hashString("early/bird"));
+
+	EarlyMediator * mediator = new EarlyMediator();
+	facade->registerMediator(mediator);
+	NotificationId id = NotificationIds::getInstance()->registerType("early/bird");
+	CHECK(NotificationIds::resolve(early) == id);
+
+	facade->sendNotification(early);
+	CHECK(mediator->m_count == 1);
+
+	Notification late("early/bird");
+	CHECK(late.getId() == id);
+	CHECK(late.getNameHash() == early.getNameHash());
+	CHECK(&late.getName() == &NotificationIds::getInstance()->getName(id));
+}
+
+static constexpr NotificationKey WALK("key/walk");
+static constexpr NotificationKey STOP("key/stop");
+static_assert(WALK.hash() == hashString("key/walk", 8), "key hashed at compile time");
+
+class KeyMediator : public Mediator
+{
+public:
+	KeyMediator() : Mediator("keys"), m_walks(0), m_stops(0) {}
+
+	virtual Interests listNotificationInterests()
+	{
+		Interests interests;
+		interests.push_back(WALK);
+		interests.push_back(STOP);
+		return interests;
+	}
+
+	virtual void handleNotification(const INotification & notification)
+	{
+		switch (notification.getNameHash())
+		{
+			case WALK.hash():
+				++m_walks;
+				break;
+			case STOP.hash():
+				++m_stops;
+				break;
+		}
+	}
+	int m_walks;
+	int m_stops;
+};
+
+static void testNotificationKey()
+{
+	TestFacade * facade = TestFacade::getInstance();
+	NotificationKey unknown("key/unknown");
+	CHECK(NotificationIds::getInstance()->getTypeIndex(unknown) == 0);
+	facade->sendNotification(unknown);
+
+	KeyMediator * mediator = new KeyMediator();
+	facade->registerMediator(mediator);
+	NotificationId walk = NotificationIds::getInstance()->getTypeIndex(WALK);
+	CHECK(walk != 0);
+	CHECK(walk == NotificationIds::getInstance()->getTypeIndex(std::string("key/walk")));
+
+	size_t before = s_allocations.load();
+	facade->sendNotification(WALK);
+	facade->sendNotification(WALK);
+	facade->sendNotification(STOP);
+	CHECK(s_allocations.load() == before);
+	CHECK(mediator->m_walks == 2);
+	CHECK(mediator->m_stops == 1);
+
+	Notification named("key/walk");
+	CHECK(WALK.matches(named));
+	CHECK(!STOP.matches(named));
+	CHECK(!unknown.matches(named));
+
+	// without ids the names are compared
+	Notification stray("key/stray");
+	CHECK(stray.getId() == 0);
+	CHECK(!WALK.matches(stray));
+	CHECK(NotificationKey("key/stray").matches(stray));
+	CHECK(NotificationIds::getInstance()->registerType(WALK) == walk);
+}
+
+// FlatHashMap against std::map under a mix of inserts and erases
+static void testFlatHashMap()
+{
+	hash_map<int, int> flat;
+	std::map<int, int> reference;
+	unsigned seed = 12345;
+	for (int i = 0; i < 20000; ++i)
+	{
+		seed = seed * 1103515245 + 12345;
+		int key = (seed >> 8) % 512;
+		if ((seed >> 4) % 3 == 0)
+		{
+			CHECK(flat.erase(key) == reference.erase(key));
+		}
+		else
+		{
+			flat[key] = i;
+			reference[key] = i;
+		}
+	}
+	CHECK(flat.size() == reference.size());
+	size_t visited = 0;
+	for (hash_map<int, int>::iterator itr = flat.begin(); itr != flat.end(); ++itr)
+	{
+		CHECK(reference[itr->first] == itr->second);
+		++visited;
+	}
+	CHECK(visited == reference.size());
+	for (int key = 0; key < 512; ++key)
+	{
+		CHECK((flat.find(key) != flat.end()) == (reference.count(key) != 0));
+	}
+
+	hash_map<std::string, int> names;
+	names["a"] = 1;
+	hash_map<std::string, int> copy(names);
+	copy["b"] = 2;
+	CHECK(names.size() == 1 && copy.size() == 2 && copy["a"] == 1);
+}
+
+// Keeps per-execution state that must start fresh every time
+class StatefulCommand : public SimpleCommand
+{
+public:
+	StatefulCommand() : m_steps(0) { ++s_live; }
+	~StatefulCommand() { --s_live; }
+
+	virtual void execute(const INotification & notification)
+	{
+		if (m_steps++ != 0)
+			++s_stale;
+		++s_executed;
+	}
+	int m_steps;
+
+	static std::atomic<int> s_live;
+	static std::atomic<int> s_stale;
+	static std::atomic<int> s_executed;
+};
+
+std::atomic<int> StatefulCommand::s_live(0);
+std::atomic<int> StatefulCommand::s_stale(0);
+std::atomic<int> StatefulCommand::s_executed(0);
+
+static void sendFactory(int rounds)
+{
+	NotificationId id = NotificationIds::getInstance()->getTypeIndex(std::string("factory"));
+	for (int i = 0; i < rounds; ++i)
+	{
+		TestFacade::getInstance()->sendNotification(id);
+	}
+}
+
+static void testCommandFactory()
+{
+	TestFacade * facade = TestFacade::getInstance();
+	facade->registerCommand<StatefulCommand>("factory");
+	CHECK(facade->hasCommand("factory"));
+
+	sendFactory(1);
+	size_t before = s_allocations.load();
+	sendFactory(100);
+	CHECK(s_allocations.load() == before);
+
+	std::vector<std::thread> threads;
+	for (int i = 0; i < 4; ++i)
+	{
+		threads.push_back(std::thread(sendFactory, 5000));
+	}
+	for (size_t i = 0; i < threads.size(); ++i)
+	{
+		threads[i].join();
+	}
+	CHECK(StatefulCommand::s_executed.load() == 1 + 100 + 4 * 5000);
+	CHECK(StatefulCommand::s_stale.load() == 0);
+	CHECK(StatefulCommand::s_live.load() == 0);
+	CHECK(CommandFactory<StatefulCommand>::getPool().capacity() <= 4);
+}
+
+// Records every handleNotifications call as name and body sequence
+class BatchMediator : public Mediator
+{
+public:
+	BatchMediator() : Mediator("batch"), m_singles(0) {}
+
+	virtual Interests listNotificationInterests()
+	{
+		Interests interests;
+		interests.push_back("batch/a");
+		interests.push_back("batch/b");
+		return interests;
+	}
+
+	virtual void handleNotification(const INotification & notification)
+	{
+		++m_singles;
+	}
+
+	virtual void handleNotifications(const INotification * const * notifications, size_t count)
+	{
+		std::vector<long> run;
+		for (size_t i = 0; i < count; ++i)
+		{
+			CHECK(notifications[i]->getName() == notifications[0]->getName());
+			run.push_back((long)const_cast<INotification *>(notifications[i])->getBody());
+		}
+		m_runs.push_back(run);
+	}
+	int m_singles;
+	std::vector<std::vector<long> > m_runs;
+};
+
+class BatchCountingMediator : public CountingMediator
+{
+public:
+	BatchCountingMediator() : CountingMediator("batchCounting") {}
+
+	virtual Interests listNotificationInterests()
+	{
+		Interests interests;
+		interests.push_back("batch/a");
+		return interests;
+	}
+};
+
+static void testSendNotifications()
+{
+	TestFacade * facade = TestFacade::getInstance();
+	BatchMediator * batched = new BatchMediator();
+	BatchCountingMediator * counting = new BatchCountingMediator();
+	facade->registerMediator(batched);
+	facade->registerMediator(counting);
+
+	Notification a1("batch/a", (void *)1), b1("batch/b", (void *)2), a2("batch/a", (void *)3);
+	Notification none("batch/none"), b2("batch/b", (void *)4), a3("batch/a", (void *)5);
+	NotificationBatch batch;
+	batch.push_back(&a1);
+	batch.push_back(&b1);
+	batch.push_back(&a2);
+	batch.push_back(&none);
+	batch.push_back(&b2);
+	batch.push_back(&a3);
+	facade->sendNotifications(batch);
+
+	CHECK(batched->m_singles == 0);
+	CHECK(batched->m_runs.size() == 2);
+	if (batched->m_runs.size() == 2)
+	{
+		std::vector<long> runA = batched->m_runs[0], runB = batched->m_runs[1];
+		if (runA.size() != 3)
+			std::swap(runA, runB);
+		CHECK(runA.size() == 3 && runA[0] == 1 && runA[1] == 3 && runA[2] == 5);
+		CHECK(runB.size() == 2 && runB[0] == 2 && runB[1] == 4);
+	}
+	CHECK(counting->m_count == 3);
+
+	facade->sendNotification(a1);
+	CHECK(batched->m_singles == 1);
+}
+
+static int s_freeCalls = 0;
+
+static void countFreeCall(const INotification &)
+{
+	++s_freeCalls;
+}
+
+static void testNotifyMethod()
+{
+	CountingMediator mediator("notifyMethod");
+	NotifyMethod empty;
+	CHECK(!empty);
+
+	NotifyMethod method = NotifyMethod::bind<IMediator, &IMediator::handleNotification>(&mediator);
+	NotifyMethod copy = method;
+	CHECK(copy == method);
+	CHECK(copy.getObject() == static_cast<IMediator *>(&mediator));
+
+	Notification notification("notifyMethod");
+	size_t before = s_allocations.load();
+	copy(notification);
+	method(notification);
+	CHECK(s_allocations.load() == before);
+	CHECK(mediator.m_count == 2);
+
+	NotifyMethod function = NotifyMethod::bind<&countFreeCall>();
+	CHECK(function && !(function == method));
+	function(notification);
+	CHECK(s_freeCalls == 1);
+}
+
+class RemovableMediator : public CountingMediator
+{
+public:
+	RemovableMediator(const std::string & name) : CountingMediator(name) {}
+
+	virtual Interests listNotificationInterests()
+	{
+		Interests interests;
+		interests.push_back("remove/a");
+		interests.push_back("remove/b");
+		return interests;
+	}
+};
+
+// Removes itself while the notification is being dispatched
+class SelfRemovingMediator : public RemovableMediator
+{
+public:
+	SelfRemovingMediator() : RemovableMediator("selfRemoving") {}
+
+	virtual void handleNotification(const INotification & notification)
+	{
+		++m_count;
+		TestFacade::getInstance()->removeMediator(getName());
+	}
+};
+
+static void testRemoveObserver()
+{
+	TestFacade * facade = TestFacade::getInstance();
+	RemovableMediator * first = new RemovableMediator("removable1");
+	RemovableMediator * second = new RemovableMediator("removable2");
+	facade->registerMediator(first);
+	facade->registerMediator(second);
+	facade->sendNotification("remove/a");
+	CHECK(first->m_count == 1 && second->m_count == 1);
+
+	CHECK(facade->removeMediator("removable1") == first);
+	delete first;
+	facade->sendNotification("remove/a");
+	facade->sendNotification("remove/b");
+	CHECK(second->m_count == 3);
+	CHECK(!facade->hasMediator("removable1"));
+
+	// removing during dispatch leaves the running dispatch intact
+	SelfRemovingMediator * self = new SelfRemovingMediator();
+	facade->registerMediator(self);
+	facade->sendNotification("remove/a");
+	facade->sendNotification("remove/a");
+	CHECK(self->m_count == 1);
+	CHECK(second->m_count == 5);
+	delete self;
+
+	// the same mediator can come back
+	facade->removeMediator("removable2");
+	facade->sendNotification("remove/b");
+	CHECK(second->m_count == 5);
+	facade->registerMediator(second);
+	facade->sendNotification("remove/b");
+	CHECK(second->m_count == 6);
+
+	// commands
+	CountingCommand * command = new CountingCommand();
+	facade->registerCommand("remove/command", command);
+	facade->sendNotification("remove/command");
+	facade->removeCommand("remove/command");
+	facade->sendNotification("remove/command");
+	CHECK(command->m_count == 1);
+	CHECK(!facade->hasCommand("remove/command"));
+	facade->registerCommand("remove/command", command);
+	facade->sendNotification("remove/command");
+	CHECK(command->m_count == 2);
+
+	// handles and contexts
+	View * view = View::getInstance();
+	CountingMediator counting("removeHandles");
+	NotificationId id = NotificationIds::getInstance()->registerType("remove/handle");
+	Subscription subscription = view->registerObserver(id,
+		NotifyMethod::bind<IMediator, &IMediator::handleNotification>(&counting), NotifyContext(&counting));
+	CHECK(subscription.isValid());
+	facade->sendNotification(id);
+	CHECK(view->removeObserver(subscription));
+	CHECK(!view->removeObserver(subscription));
+	facade->sendNotification(id);
+	CHECK(counting.m_count == 1);
+
+	NotifyMethod method = NotifyMethod::bind<IMediator, &IMediator::handleNotification>(&counting);
+	NotifyContext context(&counting);
+	Observer observer(method, context);
+	view->registerObserver("remove/handle", &observer);
+	facade->sendNotification(id);
+	view->removeObserver("remove/handle", context);
+	facade->sendNotification(id);
+	CHECK(counting.m_count == 2);
+}
+
+class CountedSingleton : public Singlton<CountedSingleton>
+{
+public:
+	CountedSingleton() { ++s_constructed; }
+	~CountedSingleton() { ++s_destroyed; }
+
+	static std::atomic<int> s_constructed;
+	static std::atomic<int> s_destroyed;
+};
+
+std::atomic<int> CountedSingleton::s_constructed(0);
+std::atomic<int> CountedSingleton::s_destroyed(0);
+
+static void touchSingleton(std::atomic<bool> * go, CountedSingleton ** seen)
+{
+	while (!go->load())
+		;
+	*seen = CountedSingleton::getInstance();
+}
+
+static void testSingleton()
+{
+	// concurrent first touch builds exactly one instance
+	std::atomic<bool> go(false);
+	std::vector<CountedSingleton *> seen(8, NULL);
+	std::vector<std::thread> threads;
+	for (size_t i = 0; i < seen.size(); ++i)
+		threads.push_back(std::thread(touchSingleton, &go, &seen[i]));
+	go = true;
+	for (size_t i = 0; i < threads.size(); ++i)
+		threads[i].join();
+	CHECK(CountedSingleton::s_constructed == 1);
+	for (size_t i = 0; i < seen.size(); ++i)
+		CHECK(seen[i] != NULL && seen[i] == seen[0]);
+
+	CountedSingleton::destroyInstance();
+	CHECK(CountedSingleton::s_destroyed == 1);
+	CHECK(!CountedSingleton::hasInstance());
+	CountedSingleton::destroyInstance();
+	CHECK(CountedSingleton::s_destroyed == 1);
+	CountedSingleton::getInstance();
+	CHECK(CountedSingleton::s_constructed == 2);
+	CountedSingleton::destroyInstance();
+
+	// tearing down the facade starts the next one from an empty core
+	TestFacade * facade = TestFacade::getInstance();
+	facade->registerCommand<StatefulCommand>("singleton/command");
+	CountingMediator * mediator = new CountingMediator("singletonMediator");
+	facade->registerMediator(mediator);
+	facade->startAsyncDispatch(2);
+	facade->postNotification("singleton/command");
+	TestFacade::destroyInstance();
+	CHECK(!TestFacade::hasInstance());
+	CHECK(!View::hasInstance() && !Controller::hasInstance() && !Model::hasInstance());
+
+	facade = TestFacade::getInstance();
+	CHECK(!facade->hasMediator("singletonMediator"));
+	CHECK(!facade->hasCommand("singleton/command"));
+	facade->sendNotification("singleton/command");
+	facade->registerMediator(mediator);
+	facade->sendNotification("tick");
+	CHECK(mediator->m_count == 1);
+	facade->removeMediator("singletonMediator");
+	delete mediator;
+	TestFacade::destroyInstance();
+}
+
+static void sendShard(TestFacade * shard, int rounds)
+{
+	for (int i = 0; i < rounds; ++i)
+		shard->sendNotification("tick");
+}
+
+static void testMultitonCores()
+{
+	TestFacade * a = TestFacade::getInstance("coreA");
+	TestFacade * b = TestFacade::getInstance("coreB");
+	CHECK(a != b && a == TestFacade::getInstance("coreA"));
+	CHECK(a->getMultitonKey() == "coreA");
+	CHECK(TestFacade::hasInstance("coreA") && !TestFacade::hasInstance("coreC"));
+	CHECK(View::getInstance("coreA") != View::getInstance("coreB"));
+	CHECK(View::getInstance("coreA") != View::getInstance());
+
+	// mediators, commands and proxies stay in their core
+	CountingMediator * inA = new CountingMediator("shardMediator");
+	CountingMediator * inB = new CountingMediator("shardMediator");
+	a->registerMediator(inA);
+	b->registerMediator(inB);
+	CountingCommand * command = new CountingCommand();
+	a->registerCommand("tick", command);
+	a->sendNotification("tick");
+	CHECK(inA->m_count == 1 && inB->m_count == 0 && command->m_count == 1);
+	CHECK(a->hasCommand("tick") && !b->hasCommand("tick"));
+	CHECK(!TestFacade::getInstance()->hasMediator("shardMediator"));
+
+	Proxy * proxy = new Proxy("shardProxy");
+	a->registerProxy(proxy);
+	CHECK(a->hasProxy("shardProxy") && !b->hasProxy("shardProxy"));
+
+	// each core driven by its own thread
+	std::thread ta(sendShard, a, 10000);
+	std::thread tb(sendShard, b, 10000);
+	ta.join();
+	tb.join();
+	CHECK(inA->m_count == 10001 && inB->m_count == 10000);
+	CHECK(command->m_count == 10001);
+
+	TestFacade::destroyInstance("coreA");
+	CHECK(!TestFacade::hasInstance("coreA"));
+	CHECK(!View::hasInstance("coreA") && !Controller::hasInstance("coreA") && !Model::hasInstance("coreA"));
+	CHECK(b->hasMediator("shardMediator"));
+	a = TestFacade::getInstance("coreA");
+	CHECK(!a->hasMediator("shardMediator") && !a->hasProxy("shardProxy"));
+	TestFacade::destroyInstance("coreA");
+	TestFacade::destroyInstance("coreB");
+	delete inA;
+	delete inB;
+	delete command;
+	delete proxy;
+}
+
+// Records the pings reaching one shard and the shard it ran on
+class ShardMediator : public Mediator
+{
+public:
+	ShardMediator(const std::string & name, const std::string & ping = "bus/ping", const std::string & type = "")
+		: Mediator(name), m_wrongShard(0), m_shard(0), m_ping(ping), m_type(type) {}
+
+	virtual Interests listNotificationInterests()
+	{
+		Interests interests;
+		interests.push_back(m_ping);
+		return interests;
+	}
+
+	virtual void handleNotification(const INotification & notification)
+	{
+		if (ShardBus::current() == NULL || ShardBus::currentShard() != m_shard || notification.getType() != m_type)
+			++m_wrongShard;
+		m_seq.push_back((long)const_cast<INotification &>(notification).getBody());
+	}
+
+	std::vector<long> m_seq;
+	int m_wrongShard;
+	size_t m_shard;
+	std::string m_ping;
+	std::string m_type;
+};
+
+// On shard 0, answers "bus/start" with a run of pings
+class PingMediator : public Mediator
+{
+public:
+	PingMediator() : Mediator("pinger") {}
+
+	virtual Interests listNotificationInterests()
+	{
+		Interests interests;
+		interests.push_back("bus/start");
+		return interests;
+	}
+
+	virtual void handleNotification(const INotification & notification)
+	{
+		long count = (long)const_cast<INotification &>(notification).getBody();
+		for (long i = 0; i < count; ++i)
+			ShardBus::current()->sendNotification(Notification("bus/ping", (void *)i));
+	}
+};
+
+// Answers "fbus/start" with pings sent through its shard's Facade,
+// counting the allocations from the first one on
+class FacadePingMediator : public Mediator
+{
+public:
+	FacadePingMediator(TestFacade * facade)
+		: Mediator("facadePinger"), m_facade(facade), m_ping("fbus/ping", NULL, "a type too long to be stored inline"), m_before(0) {}
+
+	virtual Interests listNotificationInterests()
+	{
+		Interests interests;
+		interests.push_back("fbus/start");
+		return interests;
+	}
+
+	virtual void handleNotification(const INotification & notification)
+	{
+		long count = (long)const_cast<INotification &>(notification).getBody();
+		m_before = s_allocations.load();
+		for (long i = 0; i < count; ++i)
+		{
+			m_ping.setBody((void *)i);
+			m_facade->sendNotification(m_ping);
+		}
+	}
+
+	TestFacade * m_facade;
+	Notification m_ping;
+	size_t m_before;
+};
+
+static void testShardBus()
+{
+	const long count = 1000;
+	ShardMediator * receivers[3];
+	PingMediator pinger;
+	{
+		// tiny rings, so the senders' backlogs are exercised
+		ShardBus bus("bus", 3, 4);
+		CHECK(bus.size() == 3 && bus.getShardKey(2) == "bus/2");
+		CHECK(bus.getView(1) == View::getInstance("bus/1"));
+		for (size_t i = 0; i < 3; ++i)
+		{
+			receivers[i] = new ShardMediator(bus.getShardKey(i));
+			receivers[i]->m_shard = i;
+			bus.getView(i)->registerMediator(receivers[i]);
+		}
+		bus.getView(0)->registerMediator(&pinger);
+		CHECK(ShardBus::current() == NULL);
+
+		bus.sendNotification(Notification("bus/start", (void *)count));
+		bus.flush();
+		for (size_t i = 0; i < 3; ++i)
+		{
+			CHECK(isSequence(receivers[i]->m_seq, count));
+			CHECK(receivers[i]->m_wrongShard == 0);
+		}
+
+		// idle shards park; both the outside send and the pings sent
+		// from shard 0 must wake them
+		std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+		// nothing is forwarded to a shard without observers
+		bus.getView(2)->removeMediator("bus/2");
+		bus.sendNotification(Notification("bus/start", (void *)count));
+		bus.flush();
+		CHECK(receivers[0]->m_seq.size() == 2 * count);
+		CHECK(receivers[1]->m_seq.size() == 2 * count);
+		CHECK(receivers[2]->m_seq.size() == count);
+	}
+	for (size_t i = 0; i < 3; ++i)
+	{
+		View::destroyInstance(std::string("bus/") + char('0' + i));
+		delete receivers[i];
+	}
+
+	// a shard's Facade routes through the bus, and crossing shards
+	// copies no strings, even for a name that needs the heap
+	{
+		ShardBus bus("fbus", 2, 4096);
+		TestFacade * facade = TestFacade::getInstance("fbus/0");
+		FacadePingMediator pinger(facade);
+		ShardMediator receiver("fbusReceiver", "fbus/ping", "a type too long to be stored inline");
+		receiver.m_shard = 1;
+		receiver.m_seq.reserve(2 * count);
+		facade->registerMediator(&pinger);
+		bus.getView(1)->registerMediator(&receiver);
+
+		Notification start("fbus/start", (void *)count);
+		bus.sendNotification(start);
+		bus.flush();
+		receiver.m_seq.clear();
+		bus.sendNotification(start);
+		bus.flush();
+		CHECK(s_allocations.load() == pinger.m_before);
+		CHECK(isSequence(receiver.m_seq, count));
+		CHECK(receiver.m_wrongShard == 0);
+		bus.getView(1)->removeMediator("fbusReceiver");
+		facade->removeMediator("facadePinger");
+	}
+	TestFacade::destroyInstance("fbus/0");
+	View::destroyInstance("fbus/1");
+}
+
+static std::vector<std::string> s_priorityLog;
+
+// Logs its name; stops propagation if asked to
+class PriorityMediator : public Mediator
+{
+public:
+	PriorityMediator(const std::string & name, int priority, bool consume = false)
+		: Mediator(name), m_priority(priority), m_consume(consume) {}
+
+	virtual Interests listNotificationInterests()
+	{
+		Interests interests;
+		interests.push_back("priority/event");
+		return interests;
+	}
+
+	virtual int getPriority()
+	{
+		return m_priority;
+	}
+
+	virtual void handleNotification(const INotification & notification)
+	{
+		s_priorityLog.push_back(getName());
+		if (m_consume)
+			View::stopPropagation();
+	}
+
+	int m_priority;
+	bool m_consume;
+};
+
+// Sends a nested notification that is stopped, then logs
+class NestingMediator : public PriorityMediator
+{
+public:
+	NestingMediator() : PriorityMediator("nesting", 5) {}
+
+	virtual void handleNotification(const INotification & notification)
+	{
+		TestFacade::getInstance()->sendNotification("priority/nested");
+		PriorityMediator::handleNotification(notification);
+	}
+};
+
+class NestedMediator : public Mediator
+{
+public:
+	NestedMediator() : Mediator("nested") {}
+
+	virtual Interests listNotificationInterests()
+	{
+		Interests interests;
+		interests.push_back("priority/nested");
+		return interests;
+	}
+
+	virtual void handleNotification(const INotification & notification)
+	{
+		View::stopPropagation();
+	}
+};
+
+static void testPriorityObservers()
+{
+	TestFacade * facade = TestFacade::getInstance();
+	PriorityMediator low("low", -1);
+	PriorityMediator normal1("normal1", 0);
+	PriorityMediator high("high", 10);
+	PriorityMediator normal2("normal2", 0);
+	facade->registerMediator(&low);
+	facade->registerMediator(&normal1);
+	facade->registerMediator(&high);
+	facade->registerMediator(&normal2);
+
+	// priority first, registration order within a priority
+	facade->sendNotification("priority/event");
+	const char * order[] = { "high", "normal1", "normal2", "low" };
+	CHECK(s_priorityLog.size() == 4);
+	for (size_t i = 0; i < s_priorityLog.size() && i < 4; ++i)
+		CHECK(s_priorityLog[i] == order[i]);
+
+	// a consumer ends the notification
+	PriorityMediator consumer("consumer", 5, true);
+	facade->registerMediator(&consumer);
+	s_priorityLog.clear();
+	facade->sendNotification("priority/event");
+	CHECK(s_priorityLog.size() == 2 && s_priorityLog[1] == "consumer");
+
+	// a stop inside a nested notification only ends the nested one
+	facade->removeMediator("consumer");
+	NestingMediator nesting;
+	NestedMediator nested;
+	facade->registerMediator(&nesting);
+	facade->registerMediator(&nested);
+	s_priorityLog.clear();
+	facade->sendNotification("priority/event");
+	CHECK(s_priorityLog.size() == 5 && s_priorityLog[1] == "nesting");
+
+	// batches stop per name, methods take a priority
+	facade->registerMediator(&consumer);
+	View * view = View::getInstance();
+	CountingMediator counting("priorityMethod");
+	NotificationId id = NotificationIds::getInstance()->registerType("priority/event");
+	view->registerObserver(id, NotifyMethod::bind<IMediator, &IMediator::handleNotification>(&counting),
+		NotifyContext(&counting), 20);
+	s_priorityLog.clear();
+	Notification first("priority/event");
+	Notification second("priority/event");
+	NotificationBatch batch;
+	batch.push_back(&first);
+	batch.push_back(&second);
+	facade->sendNotifications(batch);
+	CHECK(counting.m_count == 2);
+	CHECK(s_priorityLog.size() == 6 && s_priorityLog[5] == "consumer");
+
+	NotifyContext context(&counting);
+	view->removeObserver(id, context);
+	const char * names[] = { "low", "normal1", "high", "normal2", "nesting", "nested", "consumer" };
+	for (size_t i = 0; i < 7; ++i)
+		facade->removeMediator(names[i]);
+}
+
+// Records every delivery of "coalesce/state"
+class StateMediator : public Mediator
+{
+public:
+	StateMediator() : Mediator("state"), m_delivered(0) {}
+
+	virtual Interests listNotificationInterests()
+	{
+		Interests interests;
+		interests.push_back("coalesce/state");
+		return interests;
+	}
+
+	virtual void handleNotification(const INotification & notification)
+	{
+		const long * typed = notification_cast<long>(notification);
+		if (typed != NULL)
+		{
+			m_typed.push_back(*typed);
+			return;
+		}
+		m_bodies.push_back((long)const_cast<INotification &>(notification).getBody());
+		m_types.push_back(notification.getType());
+		++m_delivered;
+	}
+
+	std::vector<long> m_bodies;
+	std::vector<std::string> m_types;
+	std::vector<long> m_typed;
+	// m_bodies.size(), readable from another thread
+	std::atomic<size_t> m_delivered;
+};
+
+static void sumBodies(INotification & pending, const INotification & incoming)
+{
+	long sum = (long)pending.getBody() + (long)const_cast<INotification &>(incoming).getBody();
+	pending.setBody((void *)sum);
+}
+
+static void testCoalescing()
+{
+	TestFacade * facade = TestFacade::getInstance();
+	const std::string name("coalesce/state");
+	StateMediator state;
+	facade->registerMediator(&state);
+
+	// a burst is delivered once, with the latest body
+	facade->coalesceNotifications("coalesce/state");
+	for (long i = 1; i <= 100; ++i)
+		facade->sendNotification(Notification(name, (void *)i, "t"));
+	CHECK(state.m_bodies.empty());
+	CHECK(facade->flushCoalesced() == 1);
+	CHECK(state.m_bodies.size() == 1 && state.m_bodies[0] == 100);
+	CHECK(facade->flushCoalesced() == 0);
+
+	// a merge function, and types kept apart
+	facade->coalesceNotifications("coalesce/state", sumBodies, true);
+	for (long i = 1; i <= 10; ++i)
+		facade->sendNotification(Notification(name, (void *)i, i % 2 ? "odd" : "even"));
+	CHECK(facade->flushCoalesced() == 2);
+	CHECK(state.m_bodies.size() == 3);
+	CHECK(state.m_types[1] == "odd" && state.m_bodies[1] == 25);
+	CHECK(state.m_types[2] == "even" && state.m_bodies[2] == 30);
+
+	// the window flushes on the next arrival once it has passed; the
+	// timer thread the window starts is stopped so only the arrival can
+	facade->setCoalescingWindow(std::chrono::microseconds(1000));
+	facade->stopTimers();
+	facade->sendNotification(Notification(name, (void *)1, "odd"));
+	std::this_thread::sleep_for(std::chrono::milliseconds(5));
+	facade->sendNotification(Notification(name, (void *)2, "odd"));
+	CHECK(state.m_bodies.size() == 4 && state.m_bodies[3] == 3);
+
+	// with nothing arriving after it, a timer tick past the window
+	// delivers it
+	facade->sendNotification(Notification(name, (void *)4, "odd"));
+	CHECK(state.m_bodies.size() == 4);
+	CHECK(facade->tickTimers(NotificationTimer::Clock::now() + std::chrono::milliseconds(2)) == 1);
+	CHECK(state.m_bodies.size() == 5 && state.m_bodies[4] == 4);
+
+	// and so does the timer thread on its own
+	facade->sendNotification(Notification(name, (void *)6, "odd"));
+	facade->startTimers();
+	for (int i = 0; i < 1000 && state.m_delivered.load() < 6; ++i)
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	facade->stopTimers();
+	CHECK(state.m_delivered.load() == 6 && state.m_bodies[5] == 6);
+	facade->setCoalescingWindow(std::chrono::microseconds(0));
+
+	// a typed body is never held back; what is pending goes first
+	facade->sendNotification(Notification(name, (void *)5, "odd"));
+	facade->sendTypedNotification(name, 42L);
+	CHECK(state.m_bodies.size() == 7 && state.m_bodies[6] == 5);
+	CHECK(state.m_typed.size() == 1 && state.m_typed[0] == 42);
+
+	// a batch is coalesced like single notifications
+	Notification first(name, (void *)1, "odd");
+	Notification second(name, (void *)2, "odd");
+	NotificationBatch batch;
+	batch.push_back(&first);
+	batch.push_back(&second);
+	facade->sendNotifications(batch);
+	CHECK(state.m_bodies.size() == 7);
+	CHECK(facade->flushCoalesced() == 1);
+	CHECK(state.m_bodies.size() == 8 && state.m_bodies[7] == 3);
+
+	// stopping delivers what is pending, then notifications go straight through
+	facade->sendNotification(Notification(name, (void *)7));
+	facade->stopCoalescing("coalesce/state");
+	CHECK(state.m_bodies.size() == 9 && state.m_bodies[8] == 7);
+	facade->sendNotification(Notification(name, (void *)8));
+	CHECK(state.m_bodies.size() == 10 && state.m_bodies[9] == 8);
+
+	facade->removeMediator("state");
+}
+
+struct FireLog
+{
+	void operator()(int payload)
+	{
+		fired->push_back(payload);
+	}
+	std::vector<int> * fired;
+};
+
+static void testTimerWheel()
+{
+	typedef TimerWheel<int>::Clock Clock;
+	Clock::time_point t0 = Clock::now();
+	TimerWheel<int> wheel(std::chrono::milliseconds(1), t0);
+	std::vector<int> fired;
+	FireLog log = { &fired };
+
+	// expiries on every level, each fired on its own tick
+	const long ticks[] = { 1, 255, 256, 257, 65536 + 3, (1L << 24) + 7 };
+	const size_t count = sizeof(ticks) / sizeof(ticks[0]);
+	for (size_t i = 0; i < count; ++i)
+		wheel.schedule((int)i, t0 + std::chrono::milliseconds(ticks[i]));
+	TimerId cancelled = wheel.schedule(99, t0 + std::chrono::milliseconds(300));
+	CHECK(wheel.size() == count + 1);
+	CHECK(wheel.cancel(cancelled));
+	CHECK(!wheel.cancel(cancelled));
+	for (size_t i = 0; i < count; ++i)
+	{
+		wheel.advance(t0 + std::chrono::milliseconds(ticks[i] - 1), log);
+		CHECK(fired.size() == i);
+		wheel.advance(t0 + std::chrono::milliseconds(ticks[i]), log);
+		CHECK(fired.size() == i + 1 && fired[i] == (int)i);
+	}
+	CHECK(wheel.size() == 0);
+
+	// periodic timers repeat until cancelled; stale handles are refused
+	fired.clear();
+	Clock::time_point base = t0 + std::chrono::milliseconds(ticks[count - 1]);
+	TimerId periodic = wheel.schedule(7, base + std::chrono::milliseconds(10), std::chrono::milliseconds(10));
+	TimerId once = wheel.schedule(8, base + std::chrono::milliseconds(5));
+	wheel.advance(base + std::chrono::milliseconds(100), log);
+	CHECK(fired.size() == 11);
+	CHECK(!wheel.cancel(once));
+	CHECK(wheel.cancel(periodic));
+	wheel.advance(base + std::chrono::milliseconds(200), log);
+	CHECK(fired.size() == 11 && wheel.size() == 0);
+}
+
+static void testTimedNotifications()
+{
+	typedef NotificationTimer::Clock Clock;
+	TestFacade * facade = TestFacade::getInstance();
+	CountingMediator counting("timed");
+	facade->registerMediator(&counting);
+
+	// pumped by hand; delays count from the latest tick
+	Clock::time_point start = Clock::now();
+	facade->sendNotificationAfter("tick", std::chrono::milliseconds(50));
+	facade->tickTimers(start);
+	CHECK(counting.m_count == 0);
+	Clock::time_point now = start + std::chrono::milliseconds(60);
+	CHECK(facade->tickTimers(now) == 1);
+	CHECK(counting.m_count == 1);
+
+	TimerId every = facade->sendNotificationEvery("tick", std::chrono::milliseconds(10));
+	facade->tickTimers(now + std::chrono::milliseconds(200));
+	CHECK(counting.m_count == 21);
+	CHECK(facade->cancelNotification(every));
+	CHECK(!facade->cancelNotification(every));
+	facade->tickTimers(now + std::chrono::seconds(1));
+	CHECK(counting.m_count == 21);
+	facade->removeMediator("timed");
+
+	// by the timer thread
+	TestFacade * timed = TestFacade::getInstance("timers");
+	StressMediator stress("timed");
+	timed->registerMediator(&stress);
+	timed->startTimers();
+	timed->sendNotificationAfter("stress", std::chrono::milliseconds(5));
+	for (int i = 0; i < 1000 && stress.m_count.load() == 0; ++i)
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	CHECK(stress.m_count.load() == 1);
+	TestFacade::destroyInstance("timers");
+}
+
+static void lookupProxies(Model * model, const std::vector<ProxyHandle> * handles, std::atomic<bool> * stop, long * missing)
+{
+	while (!stop->load())
+	{
+		for (size_t i = 0; i < handles->size(); ++i)
+		{
+			if (model->retrieveProxy((*handles)[i]) == NULL || !model->hasProxy("registry/0"))
+				++*missing;
+		}
+	}
+}
+
+static void testProxyRegistry()
+{
+	Model * model = Model::getInstance("registry");
+
+	// a handle may be taken before the proxy is registered
+	ProxyHandle handle = model->getProxyHandle("registry/0");
+	CHECK(handle.isValid() && model->retrieveProxy(handle) == NULL);
+	Proxy * proxy = new Proxy("registry/0");
+	model->registerProxy(proxy);
+	CHECK(model->retrieveProxy<Proxy>(handle) == proxy);
+	CHECK(model->getProxyHandle("registry/0").index == handle.index);
+	CHECK(model->retrieveProxy(ProxyHandle()) == NULL);
+	CHECK(model->retrieveProxy(ProxyHandle(1000000)) == NULL);
+
+	// readers keep finding registered proxies while the table grows
+	std::vector<ProxyHandle> handles(1, handle);
+	std::atomic<bool> stop(false);
+	long missing = 0;
+	std::thread reader(lookupProxies, model, &handles, &stop, &missing);
+	std::vector<Proxy *> proxies;
+	for (int i = 1; i < 2000; ++i)
+	{
+		char name[32];
+		sprintf(name, "registry/%d", i);
+		proxies.push_back(new Proxy(name));
+		model->registerProxy(proxies.back());
+	}
+	stop.store(true);
+	reader.join();
+	CHECK(missing == 0);
+	for (size_t i = 0; i < proxies.size(); ++i)
+	{
+		ProxyHandle h = model->getProxyHandle(proxies[i]->getName());
+		CHECK(model->retrieveProxy(proxies[i]->getName()) == proxies[i]);
+		CHECK(model->retrieveProxy(h) == proxies[i]);
+	}
+
+	// removing keeps the handle, which sees the next registration
+	CHECK(model->removeProxy("registry/0") == proxy);
+	CHECK(model->removeProxy("registry/0") == NULL);
+	CHECK(!model->hasProxy("registry/0") && model->retrieveProxy(handle) == NULL);
+	model->registerProxy(proxy);
+	CHECK(model->retrieveProxy(handle) == proxy);
+
+	Model::destroyInstance("registry");
+	delete proxy;
+	for (size_t i = 0; i < proxies.size(); ++i)
+		delete proxies[i];
+}
+
+// Both halves are always written together
+struct Pair
+{
+	Pair() : first(0), second(0) {}
+	long first;
+	long second;
+};
+
+struct BumpPair
+{
+	bool operator()(Pair & pair) const
+	{
+		if (by == 0)
+			return false;
+		pair.first += by;
+		pair.second += by;
+		return true;
+	}
+	long by;
+};
+
+static void publishPairs(VersionedProxy<Pair> * proxy, int rounds)
+{
+	BumpPair bump = {1};
+	for (int i = 0; i < rounds; ++i)
+		proxy->update(bump);
+}
+
+static void testVersionedProxy()
+{
+	TestFacade * facade = TestFacade::getInstance();
+	CountingMediator counting("versioned");
+	facade->registerMediator(&counting);
+
+	VersionedProxy<Pair> proxy("versioned");
+	CHECK(proxy.getVersion() == 0);
+	uint64_t seen = 0;
+	Pair pair;
+	CHECK(!proxy.readIfChanged(seen, pair));
+
+	// no notification until one is asked for
+	BumpPair bump = {2};
+	CHECK(proxy.update(bump) && proxy.getVersion() == 1);
+	CHECK(counting.m_count == 0);
+	proxy.setChangeNotification(facade, "tick");
+	CHECK(proxy.update(bump) && proxy.getVersion() == 2);
+	CHECK(counting.m_count == 1);
+
+	// an update that changes nothing neither moves nor notifies
+	BumpPair none = {0};
+	CHECK(!proxy.update(none) && proxy.getVersion() == 2);
+	CHECK(counting.m_count == 1);
+
+	CHECK(proxy.readIfChanged(seen, pair) && seen == 2 && pair.first == 4);
+	CHECK(!proxy.readIfChanged(seen, pair));
+	{
+		VersionedProxy<Pair>::Reader reader(proxy);
+		Pair next;
+		next.first = next.second = 10;
+		CHECK(proxy.publish(next) == 3);
+		CHECK(reader.version() == 2 && reader->first == 4);
+	}
+	CHECK(static_cast<Pair *>(proxy.getData())->first == 10);
+	CHECK(counting.m_count == 2);
+	proxy.setChangeNotification(NULL);
+	facade->removeMediator("versioned");
+
+	// getData hands out this thread's copy, which publishing does not free
+	Pair * data = static_cast<Pair *>(proxy.getData());
+	Pair other;
+	other.first = other.second = 11;
+	proxy.publish(other);
+	proxy.publish(other);
+	CHECK(data->first == 10);
+	CHECK(static_cast<Pair *>(proxy.getData())->first == 11);
+
+	// readers on another thread never see a torn pair
+	std::thread writer(publishPairs, &proxy, 20000);
+	long torn = 0;
+	uint64_t last = 0;
+	bool ordered = true;
+	while (proxy.getVersion() < 20005)
+	{
+		VersionedProxy<Pair>::Reader reader(proxy);
+		torn += reader->first != reader->second;
+		ordered = ordered && reader.version() >= last;
+		last = reader.version();
+	}
+	writer.join();
+	CHECK(torn == 0 && ordered);
+	CHECK(proxy.readIfChanged(seen, pair) && pair.first == 20011 && pair.second == 20011);
+}
+
+// Records when it started and finished on a shared clock
+class StampCommand : public SimpleCommand
+{
+public:
+	StampCommand(std::atomic<int> * clock) : m_clock(clock), m_start(0), m_end(0), m_runs(0) {}
+	virtual void execute(const INotification & notification)
+	{
+		m_start = m_clock->fetch_add(1);
+		std::this_thread::yield();
+		m_end = m_clock->fetch_add(1);
+		m_runs.fetch_add(1);
+	}
+	std::atomic<int> * m_clock;
+	std::atomic<int> m_start;
+	std::atomic<int> m_end;
+	std::atomic<int> m_runs;
+};
+
+class ThrowingCommand : public SimpleCommand
+{
+public:
+	virtual void execute(const INotification & notification)
+	{
+		throw std::runtime_error("sub-command failed");
+	}
+};
+
+static void testMacroCommands()
+{
+	Notification note("macro");
+	std::atomic<int> clock(0);
+
+	// a MacroCommand runs its sub-commands in order
+	StampCommand first(&clock), second(&clock);
+	MacroCommand macro;
+	macro.addSubCommand(&first);
+	macro.addSubCommand(&second);
+	macro.execute(note);
+	CHECK(first.m_runs == 1 && second.m_runs == 1 && first.m_end < second.m_start);
+
+	// a diamond runs each sub-command once, after its dependencies
+	WorkStealingPool pool(2);
+	StampCommand top(&clock), left(&clock), right(&clock), bottom(&clock);
+	ParallelMacroCommand diamond(&pool);
+	size_t t = diamond.addSubCommand(&top);
+	size_t l = diamond.addSubCommand(&left, std::vector<size_t>(1, t));
+	size_t r = diamond.addSubCommand(&right, std::vector<size_t>(1, t));
+	size_t both[] = {l, r};
+	diamond.addSubCommand(&bottom, std::vector<size_t>(both, both + 2));
+	for (int i = 0; i < 200; ++i)
+	{
+		diamond.execute(note);
+		CHECK(top.m_end < left.m_start && top.m_end < right.m_start);
+		CHECK(left.m_end < bottom.m_start && right.m_end < bottom.m_start);
+	}
+	CHECK(top.m_runs == 200 && left.m_runs == 200 && right.m_runs == 200 && bottom.m_runs == 200);
+
+	// wide and nested macros, also run through the Controller
+	std::vector<StampCommand *> leaves;
+	ParallelMacroCommand outer(&pool);
+	std::vector<ParallelMacroCommand *> inners;
+	for (int i = 0; i < 4; ++i)
+	{
+		inners.push_back(new ParallelMacroCommand(&pool));
+		for (int j = 0; j < 16; ++j)
+		{
+			leaves.push_back(new StampCommand(&clock));
+			inners.back()->addSubCommand(leaves.back());
+		}
+		outer.addSubCommand(inners.back());
+	}
+	TestFacade * facade = TestFacade::getInstance();
+	facade->registerCommand("macro", &outer);
+	for (int i = 0; i < 50; ++i)
+		facade->sendNotification("macro");
+	facade->removeCommand("macro");
+	bool once = true;
+	for (size_t i = 0; i < leaves.size(); ++i)
+		once = once && leaves[i]->m_runs == 50;
+	CHECK(once);
+
+	// a failing sub-command does not stop the others
+	ThrowingCommand throwing;
+	StampCommand after(&clock), beside(&clock);
+	ParallelMacroCommand failing(&pool);
+	size_t f = failing.addSubCommand(&throwing);
+	failing.addSubCommand(&after, std::vector<size_t>(1, f));
+	failing.addSubCommand(&beside);
+	bool thrown = false;
+	try
+	{
+		failing.execute(note);
+	}
+	catch (const std::runtime_error &)
+	{
+		thrown = true;
+	}
+	CHECK(thrown && after.m_runs == 1 && beside.m_runs == 1);
+
+	// a dependency on a sub-command not added yet is rejected
+	bool rejected = false;
+	try
+	{
+		failing.addSubCommand(&beside, std::vector<size_t>(1, 3));
+	}
+	catch (const std::invalid_argument &)
+	{
+		rejected = true;
+	}
+	CHECK(rejected);
+
+	for (size_t i = 0; i < leaves.size(); ++i)
+		delete leaves[i];
+	for (size_t i = 0; i < inners.size(); ++i)
+		delete inners[i];
+}
+
+// Counts executions and remembers whether any ran on the given thread
+class ThreadCountingCommand : public SimpleCommand
+{
+public:
+	ThreadCountingCommand(std::thread::id sender) : m_sender(sender), m_count(0), m_onSender(0) {}
+	virtual void execute(const INotification & notification)
+	{
+		if (std::this_thread::get_id() == m_sender)
+			m_onSender.fetch_add(1);
+		m_count.fetch_add((long)const_cast<INotification &>(notification).getBody());
+	}
+	std::thread::id m_sender;
+	std::atomic<long> m_count;
+	std::atomic<int> m_onSender;
+};
+
+// Remembers the name of the last notification it ran for
+class NameCommand : public SimpleCommand
+{
+public:
+	virtual void execute(const INotification & notification)
+	{
+		m_name = notification.getName();
+	}
+	std::string m_name;
+};
+
+// Whether flushCommands threw a command's runtime_error
+static bool flushThrows(TestFacade * facade)
+{
+	try
+	{
+		facade->flushCommands();
+	}
+	catch (const std::runtime_error &)
+	{
+		return true;
+	}
+	return false;
+}
+
+static void testWorkStealingExecutor()
+{
+	// async commands run on the pool, off the sending thread
+	WorkStealingPool pool(2);
+	CHECK(pool.size() == 2);
+	TestFacade * facade = TestFacade::getInstance("executor");
+	Controller::getInstance("executor")->setCommandExecutor(&pool);
+	ThreadCountingCommand command(std::this_thread::get_id());
+	facade->registerAsyncCommand("async", &command);
+	for (long i = 0; i < 1000; ++i)
+		facade->sendNotification(Notification("async", (void *)2));
+	facade->flushCommands();
+	CHECK(command.m_count.load() == 2000);
+	facade->removeCommand("async");
+
+	// a throwing async command neither kills the worker nor hangs the
+	// flush; the flush reports it, once
+	ThrowingCommand throwing;
+	facade->registerAsyncCommand("async/throw", &throwing);
+	facade->sendNotification("async/throw");
+	facade->sendNotification("async/throw");
+	CHECK(flushThrows(facade));
+	CHECK(!flushThrows(facade));
+	facade->removeCommand("async/throw");
+
+	// a notification built before its name was registered keeps its name
+	Notification early("async/early");
+	CHECK(early.getId() == 0);
+	NameCommand named;
+	facade->registerAsyncCommand("async/early", &named);
+	facade->sendNotification(early);
+	facade->flushCommands();
+	CHECK(named.m_name == "async/early");
+	facade->removeCommand("async/early");
+
+	// pooled async dispatch keeps per-name order
+	SequenceMediator * mediator = new SequenceMediator();
+	facade->registerMediator(mediator);
+	facade->startAsyncDispatch(pool, 4, 16, AsyncDispatcher::BLOCK);
+	const long count = 5000;
+	for (long i = 0; i < count; ++i)
+	{
+		CHECK(facade->postNotification("seqA", (void *)i));
+		CHECK(facade->postNotification("seqB", (void *)i));
+	}
+	facade->flushNotifications();
+	CHECK(isSequence(mediator->m_a, count));
+	CHECK(isSequence(mediator->m_b, count));
+
+	// a throwing observer does not stall its strand
+	ThrowingMediator throwingMediator;
+	facade->registerMediator(&throwingMediator);
+	CHECK(facade->postNotification("post/throw"));
+	CHECK(facade->postNotification("seqA", (void *)count));
+	CHECK(flushNotificationsThrows(facade));
+	CHECK(!flushNotificationsThrows(facade));
+	CHECK(mediator->m_a.size() == count + 1);
+	facade->removeMediator("throwing");
+	facade->stopAsyncDispatch();
+
+	// tasks submitted from inside the pool are stolen by idle workers
+	std::atomic<int> clock(0);
+	ParallelMacroCommand wide(&pool);
+	std::vector<StampCommand *> leaves;
+	for (int i = 0; i < 64; ++i)
+	{
+		leaves.push_back(new StampCommand(&clock));
+		wide.addSubCommand(leaves.back());
+	}
+	facade->registerAsyncCommand("wide", &wide);
+	for (int i = 0; i < 20; ++i)
+		facade->sendNotification("wide");
+	facade->flushCommands();
+	bool all = true;
+	for (size_t i = 0; i < leaves.size(); ++i)
+		all = all && leaves[i]->m_runs == 20;
+	CHECK(all);
+
+	// remapping a command frees the factory and wrapper created for the
+	// old mapping instead of keeping them until shutdown
+	facade->registerCommand<StatefulCommand>("remap");
+	facade->registerAsyncCommand<StatefulCommand>("remap/async");
+	facade->sendNotification("remap");
+	facade->sendNotification("remap/async");
+	facade->flushCommands();
+	size_t live = s_allocations.load() - s_frees.load();
+	for (int i = 0; i < 1000; ++i)
+	{
+		facade->registerCommand<StatefulCommand>("remap");
+		facade->sendNotification("remap");
+		facade->registerAsyncCommand<StatefulCommand>("remap/async");
+		facade->sendNotification("remap/async");
+	}
+	facade->removeCommand("remap");
+	facade->removeCommand("remap/async");
+	facade->flushCommands();
+	CHECK(s_allocations.load() - s_frees.load() < live + 100);
+	CHECK(!facade->hasCommand("remap"));
+
+#ifdef __linux__
+	CHECK(pool.pinWorkers(std::vector<int>(1, 0)));
+#endif
+	TestFacade::destroyInstance("executor");
+	delete mediator;
+	for (size_t i = 0; i < leaves.size(); ++i)
+		delete leaves[i];
+}
+
+int main(int argc, char * argv[])
+{
+	testZeroAllocationDispatch();
+	testRegisterDuringDispatch();
+	testConcurrentDispatch();
+	testAsyncDispatch();
+	testTypedNotification();
+	testResolveByHash();
+	testNotificationKey();
+	testFlatHashMap();
+	testCommandFactory();
+	testSendNotifications();
+	testNotifyMethod();
+	testRemoveObserver();
+	testSingleton();
+	testMultitonCores();
+	testShardBus();
+	testPriorityObservers();
+	testCoalescing();
+	testTimerWheel();
+	testTimedNotifications();
+	testProxyRegistry();
+	testVersionedProxy();
+	testMacroCommands();
+	testWorkStealingExecutor();
+
+	if (s_failures != 0)
+	{
+		std::cout << s_failures << " check(s) failed" << std::endl;
+		return 1;
+	}
+	std::cout << "all checks passed" << std::endl;
+	return 0;
+}
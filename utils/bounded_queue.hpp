@@ -0,0 +1,159 @@
+#ifndef __BOUNDED_QUEUE_HPP__
+#define __BOUNDED_QUEUE_HPP__
+
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <cstddef>
+
+/**
+ * A blocking FIFO shared by any number of producers and consumers.
+ *
+ * <P>
+ * The queue holds at most <code>capacity</code> items. What happens
+ * when a producer finds it full is decided by the overflow policy:
+ * <UL>
+ * <LI><code>BLOCK</code> waits until a consumer makes room.</LI>
+ * <LI><code>DROP</code> discards the new item and returns false.</LI>
+ * <LI><code>GROW</code> ignores the bound and always accepts the item.</LI>
+ * </UL></P>
+ *
+ * <P>
+ * Consumers call <code>done</code> once they have finished with an
+ * item they popped, which lets <code>flush</code> wait until every
+ * accepted item has been fully processed.</P>
+ */
+template <class T>
+class BoundedQueue
+{
+    public:
+        enum OverflowPolicy
+        {
+            BLOCK,
+            DROP,
+            GROW
+        };
+
+        BoundedQueue(size_t capacity = 1024, OverflowPolicy policy = BLOCK)
+            :m_capacity(capacity ? capacity : 1), m_policy(policy),
+             m_pending(0), m_closed(false)
+        {
+        }
+
+        /**
+         * Append an item.
+         *
+         * @return false if the item was dropped or the queue is closed.
+         */
+        bool push(const T & item)
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            while (!m_closed && m_policy != GROW && m_items.size() >= m_capacity)
+            {
+                if (m_policy == DROP)
+                    return false;
+                m_notFull.wait(lock);
+            }
+            if (m_closed)
+                return false;
+
+            m_items.push_back(item);
+            ++m_pending;
+            lock.unlock();
+            m_notEmpty.notify_one();
+            return true;
+        }
+
+        /**
+         * Take the oldest item, waiting for one if the queue is empty.
+         *
+         * @return false once the queue is closed and empty.
+         */
+        bool pop(T & item)
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            while (m_items.empty())
+            {
+                if (m_closed)
+                    return false;
+                m_notEmpty.wait(lock);
+            }
+            item = m_items.front();
+            m_items.pop_front();
+            lock.unlock();
+            m_notFull.notify_one();
+            return true;
+        }
+
+        /**
+         * Take the oldest item if there is one, without waiting.
+         *
+         * @return false if the queue is empty.
+         */
+        bool tryPop(T & item)
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            if (m_items.empty())
+                return false;
+            item = m_items.front();
+            m_items.pop_front();
+            lock.unlock();
+            m_notFull.notify_one();
+            return true;
+        }
+
+        /**
+         * Mark an item returned by <code>pop</code> or <code>tryPop</code> as processed.
+         */
+        void done()
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (--m_pending == 0)
+                m_idle.notify_all();
+        }
+
+        /**
+         * Wait until every accepted item has been popped and processed.
+         */
+        void flush()
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            while (m_pending != 0)
+                m_idle.wait(lock);
+        }
+
+        /**
+         * Refuse new items; consumers drain what is left and then stop.
+         */
+        void close()
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_closed = true;
+            m_notEmpty.notify_all();
+            m_notFull.notify_all();
+        }
+
+        size_t size()
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            return m_items.size();
+        }
+
+    private:
+        BoundedQueue(const BoundedQueue &);
+        BoundedQueue & operator = (const BoundedQueue &);
+
+        std::deque<T> m_items;
+        size_t m_capacity;
+        OverflowPolicy m_policy;
+        // items accepted but not yet done
+        size_t m_pending;
+        bool m_closed;
+
+        std::mutex m_mutex;
+        std::condition_variable m_notEmpty;
+        std::condition_variable m_notFull;
+        std::condition_variable m_idle;
+};
+
+#endif //
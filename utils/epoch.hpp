@@ -0,0 +1,194 @@
+#ifndef __EPOCH_HPP__
+#define __EPOCH_HPP__
+
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <cstddef>
+
+/**
+ * Epoch based deferred reclamation for read-mostly structures.
+ *
+ * <P>
+ * Readers bracket every access to a published snapshot with a
+ * <code>EpochDomain::Guard</code>. Entering and leaving a guard is a
+ * pair of atomic increments on a per-thread stripe, so readers never
+ * take a lock and never allocate.</P>
+ *
+ * <P>
+ * Writers publish a new snapshot with an atomic store and hand the
+ * old one to <code>retire</code>. A retired snapshot is deleted once
+ * every reader that could still be looking at it has left its guard.
+ * Reclamation never waits for readers, so a writer running inside a
+ * guard (e.g. a mediator registering another mediator from
+ * <code>handleNotification</code>) cannot deadlock; the garbage is
+ * simply freed by a later <code>retire</code> or by the destructor.</P>
+ *
+ * <P>
+ * <code>retire</code> is not thread-safe: writers must serialise among
+ * themselves, which they already do to build the new snapshot.</P>
+ */
+class EpochDomain
+{
+    public:
+        enum { STRIPES = 16 };
+
+        class Guard
+        {
+            public:
+                explicit Guard(const EpochDomain & domain)
+                    :m_counter(domain.enter())
+                {
+                }
+
+                ~Guard()
+                {
+                    m_counter->fetch_sub(1);
+                }
+
+            private:
+                Guard(const Guard &);
+                Guard & operator = (const Guard &);
+
+                std::atomic<long> * m_counter;
+        };
+
+        EpochDomain()
+            :m_epoch(0)
+        {
+            for (int e = 0; e < 2; ++e)
+                for (int i = 0; i < STRIPES; ++i)
+                    m_readers[e][i].count.store(0);
+        }
+
+        ~EpochDomain()
+        {
+            // no reader may outlive the structure it protects
+            reclaim(0);
+            reclaim(1);
+        }
+
+        /**
+         * Defer deletion of an unpublished snapshot.
+         *
+         * @param object the snapshot that is no longer reachable by new readers.
+         */
+        template <class T>
+        void retire(const T * object)
+        {
+            if (object == NULL)
+                return;
+
+            Retired retired;
+            retired.object = object;
+            retired.destroy = &destroy<T>;
+            m_garbage[m_epoch.load() & 1].push_back(retired);
+            advance();
+        }
+
+        /**
+         * Wait until every reader that entered a guard before the call
+         * has left it, and free everything retired so far.
+         *
+         * <P>
+         * Serialised with <code>retire</code> like any writer, and must
+         * not be called from inside a guard of this domain.</P>
+         */
+        void synchronize()
+        {
+            // two epoch moves: readers counted in either parity are gone
+            unsigned epoch = m_epoch.load();
+            while (m_epoch.load() - epoch < 2)
+            {
+                unsigned before = m_epoch.load();
+                advance();
+                if (m_epoch.load() == before)
+                    std::this_thread::yield();
+            }
+        }
+
+    private:
+        struct Retired
+        {
+            const void * object;
+            void (*destroy)(const void *);
+        };
+        typedef std::vector<Retired> RetiredList;
+
+        // keep every counter on its own cache line
+        struct Stripe
+        {
+            std::atomic<long> count;
+            char pad[64 - sizeof(std::atomic<long>)];
+        };
+
+        template <class T>
+        static void destroy(const void * object)
+        {
+            delete static_cast<const T *>(object);
+        }
+
+        static size_t stripe()
+        {
+            static std::atomic<size_t> s_next(0);
+            static thread_local size_t s_stripe = s_next.fetch_add(1) % STRIPES;
+            return s_stripe;
+        }
+
+        std::atomic<long> * enter() const
+        {
+            size_t s = stripe();
+            for (;;)
+            {
+                unsigned epoch = m_epoch.load();
+                std::atomic<long> * counter = &m_readers[epoch & 1][s].count;
+                counter->fetch_add(1);
+                // the epoch may have moved on between the load and the
+                // increment; readers must be counted in the live epoch
+                if (m_epoch.load() == epoch)
+                    return counter;
+                counter->fetch_sub(1);
+            }
+        }
+
+        bool quiescent(unsigned parity) const
+        {
+            for (int i = 0; i < STRIPES; ++i)
+            {
+                if (m_readers[parity][i].count.load() != 0)
+                    return false;
+            }
+            return true;
+        }
+
+        // Move to the next epoch once the readers of the previous one
+        // are gone, and free what was retired during that epoch
+        void advance()
+        {
+            unsigned epoch = m_epoch.load();
+            unsigned next = (epoch + 1) & 1;
+            if (!quiescent(next))
+                return;
+            m_epoch.store(epoch + 1);
+            reclaim(next);
+        }
+
+        void reclaim(unsigned parity)
+        {
+            RetiredList & garbage = m_garbage[parity];
+            for (size_t i = 0; i < garbage.size(); ++i)
+            {
+                garbage[i].destroy(garbage[i].object);
+            }
+            garbage.clear();
+        }
+
+        EpochDomain(const EpochDomain &);
+        EpochDomain & operator = (const EpochDomain &);
+
+        std::atomic<unsigned> m_epoch;
+        mutable Stripe m_readers[2][STRIPES];
+        RetiredList m_garbage[2];
+};
+
+#endif //
@@ -0,0 +1,373 @@
+#ifndef __FLAT_HASH_MAP_HPP__
+#define __FLAT_HASH_MAP_HPP__
+#include <vector>
+#include <utility>
+#include <cstddef>
+#include <functional>
+#include <stdint.h>
+
+/**
+ * An open-addressing hash map using Robin Hood linear probing.
+ *
+ * <P>
+ * Entries live in one flat array instead of one heap node each, so a
+ * lookup touches a handful of adjacent cache lines and an insert that
+ * does not grow the table allocates nothing. A parallel array of
+ * small <code>Meta</code> records holds each slot's probe distance and
+ * a fragment of its hash; probing scans that array and only compares
+ * keys whose fragment matches.</P>
+ *
+ * <P>
+ * Robin Hood insertion keeps probe sequences short: an entry that is
+ * further from its home bucket takes the slot of one that is closer.
+ * A lookup stops as soon as it meets an entry closer to home than the
+ * key would be. Erase shifts the following entries back, so there are
+ * no tombstones.</P>
+ *
+ * <P>
+ * The interface is the subset of <code>hash_map</code> the framework
+ * uses. Unlike a node-based map, inserting or erasing invalidates all
+ * iterators and references. <code>K</code> and <code>V</code> must be
+ * default constructible.</P>
+ */
+template <class K, class V, class H, class E = std::equal_to<K> >
+class FlatHashMap
+{
+    public:
+        typedef K key_type;
+        typedef V mapped_type;
+        typedef std::pair<K, V> value_type;
+
+        class iterator;
+        class const_iterator;
+
+        FlatHashMap()
+            :m_size(0), m_mask(0)
+        {
+        }
+
+        size_t size() const
+        {
+            return m_size;
+        }
+
+        bool empty() const
+        {
+            return m_size == 0;
+        }
+
+        void clear()
+        {
+            m_meta.clear();
+            m_slots.clear();
+            m_size = 0;
+            m_mask = 0;
+        }
+
+        iterator begin()
+        {
+            return iterator(this, next(0));
+        }
+
+        iterator end()
+        {
+            return iterator(this, m_meta.size());
+        }
+
+        const_iterator begin() const
+        {
+            return const_iterator(this, next(0));
+        }
+
+        const_iterator end() const
+        {
+            return const_iterator(this, m_meta.size());
+        }
+
+        iterator find(const K & key)
+        {
+            return iterator(this, locate(key));
+        }
+
+        const_iterator find(const K & key) const
+        {
+            return const_iterator(this, locate(key));
+        }
+
+        size_t count(const K & key) const
+        {
+            return locate(key) != m_meta.size() ? 1 : 0;
+        }
+
+        V & operator [] (const K & key)
+        {
+            size_t pos = locate(key);
+            if (pos == m_meta.size())
+            {
+                pos = place(value_type(key, V()));
+            }
+            return m_slots[pos].second;
+        }
+
+        /**
+         * Insert <code>value</code> unless its key is already present.
+         *
+         * @return the entry for the key, and whether it was inserted.
+         */
+        std::pair<iterator, bool> insert(const value_type & value)
+        {
+            size_t pos = locate(value.first);
+            if (pos != m_meta.size())
+            {
+                return std::make_pair(iterator(this, pos), false);
+            }
+            return std::make_pair(iterator(this, place(value)), true);
+        }
+
+        void erase(iterator itr)
+        {
+            remove(itr.m_pos);
+        }
+
+        size_t erase(const K & key)
+        {
+            size_t pos = locate(key);
+            if (pos == m_meta.size())
+                return 0;
+            remove(pos);
+            return 1;
+        }
+
+        class iterator
+        {
+            public:
+                iterator()
+                    :m_map(NULL), m_pos(0)
+                {
+                }
+
+                value_type & operator * () const
+                {
+                    return m_map->m_slots[m_pos];
+                }
+
+                value_type * operator -> () const
+                {
+                    return &m_map->m_slots[m_pos];
+                }
+
+                iterator & operator ++ ()
+                {
+                    m_pos = m_map->next(m_pos + 1);
+                    return *this;
+                }
+
+                bool operator == (const iterator & other) const
+                {
+                    return m_pos == other.m_pos;
+                }
+
+                bool operator != (const iterator & other) const
+                {
+                    return m_pos != other.m_pos;
+                }
+
+            private:
+                friend class FlatHashMap;
+                friend class const_iterator;
+
+                iterator(FlatHashMap * map, size_t pos)
+                    :m_map(map), m_pos(pos)
+                {
+                }
+
+                FlatHashMap * m_map;
+                size_t m_pos;
+        };
+
+        class const_iterator
+        {
+            public:
+                const_iterator()
+                    :m_map(NULL), m_pos(0)
+                {
+                }
+
+                const_iterator(const iterator & other)
+                    :m_map(other.m_map), m_pos(other.m_pos)
+                {
+                }
+
+                const value_type & operator * () const
+                {
+                    return m_map->m_slots[m_pos];
+                }
+
+                const value_type * operator -> () const
+                {
+                    return &m_map->m_slots[m_pos];
+                }
+
+                const_iterator & operator ++ ()
+                {
+                    m_pos = m_map->next(m_pos + 1);
+                    return *this;
+                }
+
+                bool operator == (const const_iterator & other) const
+                {
+                    return m_pos == other.m_pos;
+                }
+
+                bool operator != (const const_iterator & other) const
+                {
+                    return m_pos != other.m_pos;
+                }
+
+            private:
+                friend class FlatHashMap;
+
+                const_iterator(const FlatHashMap * map, size_t pos)
+                    :m_map(map), m_pos(pos)
+                {
+                }
+
+                const FlatHashMap * m_map;
+                size_t m_pos;
+        };
+
+    private:
+        /**
+         * Per-slot probe distance plus one (0 marks an empty slot) and
+         * the low bits of the key's hash.
+         */
+        struct Meta
+        {
+            uint32_t distance;
+            uint32_t fragment;
+        };
+
+        static const size_t MIN_CAPACITY = 8;
+
+        // Fibonacci hashing spreads weak hashes such as identity-hashed
+        // integers and pointers over the whole table
+        size_t home(size_t hash) const
+        {
+            return (size_t)(((uint64_t)hash * 0x9E3779B97F4A7C15ULL) >> 32) & m_mask;
+        }
+
+        size_t next(size_t pos) const
+        {
+            while (pos < m_meta.size() && m_meta[pos].distance == 0)
+            {
+                ++pos;
+            }
+            return pos;
+        }
+
+        /**
+         * @return the slot holding <code>key</code>, or the capacity if it is absent.
+         */
+        size_t locate(const K & key) const
+        {
+            if (m_size == 0)
+                return m_meta.size();
+
+            size_t hash = m_hasher(key);
+            uint32_t fragment = (uint32_t)hash;
+            size_t pos = home(hash);
+            for (uint32_t distance = 1; ; ++distance)
+            {
+                const Meta & meta = m_meta[pos];
+                if (meta.distance < distance)
+                    return m_meta.size();
+                if (meta.distance == distance && meta.fragment == fragment &&
+                        m_equal(m_slots[pos].first, key))
+                    return pos;
+                pos = (pos + 1) & m_mask;
+            }
+        }
+
+        /**
+         * Insert a key known to be absent.
+         *
+         * @return the slot it ended up in.
+         */
+        size_t place(value_type value)
+        {
+            if ((m_size + 1) * 8 > m_meta.size() * 7)
+            {
+                rehash(m_meta.empty() ? MIN_CAPACITY : m_meta.size() * 2);
+            }
+
+            size_t hash = m_hasher(value.first);
+            Meta meta;
+            meta.distance = 1;
+            meta.fragment = (uint32_t)hash;
+            size_t pos = home(hash);
+            size_t result = m_meta.size();
+            for (;;)
+            {
+                Meta & slot = m_meta[pos];
+                if (slot.distance == 0)
+                {
+                    slot = meta;
+                    m_slots[pos] = std::move(value);
+                    ++m_size;
+                    return result != m_meta.size() ? result : pos;
+                }
+                if (slot.distance < meta.distance)
+                {
+                    // take the slot from an entry closer to its home
+                    std::swap(slot, meta);
+                    std::swap(m_slots[pos], value);
+                    if (result == m_meta.size())
+                        result = pos;
+                }
+                pos = (pos + 1) & m_mask;
+                ++meta.distance;
+            }
+        }
+
+        void remove(size_t pos)
+        {
+            size_t following = (pos + 1) & m_mask;
+            while (m_meta[following].distance > 1)
+            {
+                m_meta[pos] = m_meta[following];
+                --m_meta[pos].distance;
+                m_slots[pos] = std::move(m_slots[following]);
+                pos = following;
+                following = (following + 1) & m_mask;
+            }
+            m_meta[pos].distance = 0;
+            m_slots[pos] = value_type();
+            --m_size;
+        }
+
+        void rehash(size_t capacity)
+        {
+            std::vector<Meta> meta(capacity);
+            std::vector<value_type> slots(capacity);
+            m_meta.swap(meta);
+            m_slots.swap(slots);
+            m_mask = capacity - 1;
+            m_size = 0;
+            for (size_t i = 0; i < meta.size(); ++i)
+            {
+                if (meta[i].distance != 0)
+                {
+                    place(std::move(slots[i]));
+                }
+            }
+        }
+
+        std::vector<Meta> m_meta;
+        std::vector<value_type> m_slots;
+        size_t m_size;
+        size_t m_mask;
+        H m_hasher;
+        E m_equal;
+};
+
+#endif //
@@ -3,7 +3,68 @@
 
 #include "hash_map.hpp"
 #include <string>
-#ifndef WIN32 
+#include <cstddef>
+
+#define FNV_OFFSET_BASIS ((size_t)14695981039346656037ULL)
+#define FNV_PRIME ((size_t)1099511628211ULL)
+
+/**
+ * FNV-1a hash of a byte string.
+ *
+ * <P>
+ * <code>constexpr</code>, so string literals can be hashed at compile
+ * time to the same value the runtime computes. Written as a single
+ * recursive return statement to stay within C++11; runtime callers
+ * with a <code>std::string</code> use the loop below.</P>
+ */
+inline constexpr size_t hashString(const char * data, size_t length, size_t h = FNV_OFFSET_BASIS)
+{
+    return length == 0 ? h :
+        hashString(data + 1, length - 1, (h ^ (unsigned char)data[0]) * FNV_PRIME);
+}
+
+inline size_t hashString(const std::string & data)
+{
+    size_t h = FNV_OFFSET_BASIS;
+    for (size_t i = 0; i < data.size(); ++i)
+    {
+        h ^= (unsigned char)data[i];
+        h *= FNV_PRIME;
+    }
+    return h;
+}
+
+/**
+ * A string key carrying its precomputed hash.
+ *
+ * <P>
+ * Hashing a <code>NameKey</code> just returns the stored hash, so a
+ * string hashed once can be looked up any number of times. The key
+ * only points at the string: a lookup key can refer to a caller's
+ * string without copying it, and a stored key must point at a string
+ * that outlives the container.</P>
+ */
+struct NameKey
+{
+    NameKey()
+        :hash(0), name(NULL)
+    {
+    }
+
+    NameKey(size_t h, const std::string * n)
+        :hash(h), name(n)
+    {
+    }
+
+    bool operator == (const NameKey & other) const
+    {
+        return hash == other.hash && *name == *other.name;
+    }
+
+    size_t hash;
+    const std::string * name;
+};
+
 namespace HASH_MAP_NAMESPACE
 {
     template<>
@@ -11,13 +72,19 @@ namespace HASH_MAP_NAMESPACE
         {
             size_t operator()(const std::string& data) const
             {
-                return __stl_hash_string(data.c_str());
+                return hashString(data);
             }
         };
-}
-#else 
 
-#endif // 
+    template<>
+        struct hash<NameKey>
+        {
+            size_t operator()(const NameKey& key) const
+            {
+                return key.hash;
+            }
+        };
+}
 
 
 
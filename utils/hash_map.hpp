@@ -1,18 +1,36 @@
 #ifndef __HASH_MAP_HPP__
-#define __HASH_MAP_HPP__ 
+#define __HASH_MAP_HPP__
+
+// hash_map used to be __gnu_cxx::hash_map, stdext::hash_map or std::map
+// depending on the compiler. It is now the open-addressing FlatHashMap
+// everywhere; define PUREMVC_STD_HASH_MAP to plug in std::unordered_map
+// instead. Hash functions are still specialised in HASH_MAP_NAMESPACE.
+//
+// GCC, Clang, ICC and MSVC all take the same path: FlatHashMap is plain
+// C++11 with no compiler-specific code. The old stdext::hash_map (MSVC)
+// and std::hash_map (ICC) branches are gone with the containers they
+// selected; Visual C++ needs 2015 (_MSC_VER 1900) or later for the
+// alias template below and the rest of the C++11 the framework uses.
+
+#if defined(_MSC_VER) && (_MSC_VER < 1900)
+#error "PureMVC C++ needs Visual Studio 2015 or later (C++11)"
+#endif
 
-// !cj! if all these machine have to use map then we can just delete them and use the default 
+#include <functional>
+#include <unordered_map>
+#include "flat_hash_map.hpp"
 
-#  if ( (__GNUC__ == 3) && (__GNUC_MINOR__ >= 1) ) || ( __GNUC__ > 3 )
-#    include <ext/hash_map>
-#    include <ext/hash_set>
-#    define HASH_MAP_NAMESPACE __gnu_cxx
-#    define HashMap __gnu_cxx::hash_map
-#    define HashSet __gnu_cxx::hash_set
+#define HASH_MAP_NAMESPACE flat
+#define HashMap flat::hash_map
 
-// this allows us to hash on a pointer as the key 
 namespace HASH_MAP_NAMESPACE
 {
+    template <class T>
+        struct hash : std::hash<T>
+        {
+        };
+
+    // this allows us to hash on a pointer as the key
     template <class T>
         struct hash<T*>
         {
@@ -22,6 +40,13 @@ namespace HASH_MAP_NAMESPACE
             }
         };
 
+#ifdef PUREMVC_STD_HASH_MAP
+    template <class K, class V, class H = hash<K> >
+        using hash_map = std::unordered_map<K, V, H>;
+#else
+    template <class K, class V, class H = hash<K> >
+        using hash_map = FlatHashMap<K, V, H>;
+#endif
 }
 
 #define HashValue(type)                           \
@@ -32,42 +57,7 @@ namespace HASH_MAP_NAMESPACE
     {                                                 \
         size_t operator()(const type& data) const;  \
     };                                                \
-}                                   
+}
 #define HashValueImp(type, ret) size_t HASH_MAP_NAMESPACE::hash<type>::operator()(const type& data) const { return ret; }
 
-#  elif  defined(__INTEL_COMPILER )
-#    include <hash_map>
-#    define HASH_MAP_NAMESPACE std
-#    define HashMap std::hash_map
-#    define HashSet std::hash_set
-#    define HashValue(type)              \
-    namespace HASH_MAP_NAMESPACE        \
-{                                   \
-    size_t hash_value(const type& data);\
-}                                   
-#    define HashValueImp(type, ret) size_t HASH_MAP_NAMESPACE::hash_value(const type& data) { return ret; }
-#  elif  defined(WIN32) && defined(_MSC_VER) && (_MSC_VER >= 1310)  // hash_map is in stdext namespace for VS.NET 2003
-#    include <hash_map>
-#    include <hash_set>
-#    define HASH_MAP_NAMESPACE stdext
-#    define HashMap stdext::hash_map
-#    define HashSet stdext::hash_set
-#    define HashValue(type)              \
-    namespace HASH_MAP_NAMESPACE        \
-{                                   \
-    size_t hash_value(const type& data);\
-}                                   
-#    define HashValueImp(type, ret) size_t HASH_MAP_NAMESPACE::hash_value(const type& data) { return ret; }
-#  else
-#    include <map>
-#    define HashMap std::map
-#    define HashSet std::set
-#    define HashValue(type)    
-#    define HashValueImp(type, ret) 
-#  endif
-
-
 #endif
-
-
-
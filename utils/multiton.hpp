@@ -0,0 +1,84 @@
+#ifndef __MULTITON_HPP__
+#define __MULTITON_HPP__
+
+#include <map>
+#include <mutex>
+#include <string>
+
+/**
+ * Base class of the framework's Multitons: one instance per key.
+ *
+ * <P>
+ * <code>getInstance(key)</code> returns the instance registered under
+ * <code>key</code>, constructing a <code>T(key)</code> the first time.
+ * The registry is guarded by a mutex, so instances are meant to be
+ * looked up once and the pointer kept; the cores built on top do
+ * exactly that and share nothing after construction.</P>
+ *
+ * <P>
+ * <code>destroyInstance(key)</code> deletes the instance of one key.
+ * No other thread may be using that instance while it is destroyed.</P>
+ */
+template <class T>
+class Multiton
+{
+    protected:
+        Multiton()  {}
+    public:
+        static T* getInstance(const std::string & key)
+        {
+            std::lock_guard<std::mutex> lock(getMutex());
+            typename Instances::iterator itr = getInstances().find(key);
+            if (itr != getInstances().end())
+            {
+                return itr->second;
+            }
+            T * ins = new T(key);
+            getInstances()[key] = ins;
+            return ins;
+        }
+
+        /**
+         * Delete the instance of <code>key</code>, if any.
+         */
+        static void destroyInstance(const std::string & key)
+        {
+            T * ins = 0;
+            {
+                std::lock_guard<std::mutex> lock(getMutex());
+                typename Instances::iterator itr = getInstances().find(key);
+                if (itr == getInstances().end())
+                    return;
+                ins = itr->second;
+                getInstances().erase(itr);
+            }
+            delete ins;
+        }
+
+        static bool hasInstance(const std::string & key)
+        {
+            std::lock_guard<std::mutex> lock(getMutex());
+            return getInstances().count(key) != 0;
+        }
+
+        ~Multiton()
+        {
+        }
+    private:
+        typedef std::map<std::string, T *> Instances;
+
+        static Instances & getInstances()
+        {
+            static Instances s_instances;
+            return s_instances;
+        }
+
+        static std::mutex & getMutex()
+        {
+            static std::mutex s_mutex;
+            return s_mutex;
+        }
+};
+
+
+#endif //
@@ -0,0 +1,106 @@
+#ifndef __OBJECT_POOL_HPP__
+#define __OBJECT_POOL_HPP__
+
+#include <mutex>
+#include <new>
+#include <vector>
+#include <cstddef>
+#include <type_traits>
+
+/**
+ * A thread-safe pool of storage for objects of type <code>T</code>.
+ *
+ * <P>
+ * <code>construct</code> builds a fresh <code>T</code> in a block taken
+ * from the pool and <code>destroy</code> runs its destructor and puts
+ * the block back, so objects never see state left over by a previous
+ * one while the heap is only touched when the pool has to grow. Blocks
+ * are released when the pool itself is destroyed.</P>
+ *
+ * <P>
+ * Free blocks form an intrusive list guarded by a mutex held only for
+ * the push or pop.</P>
+ */
+template <class T>
+class ObjectPool
+{
+    public:
+        ObjectPool()
+            :m_free(NULL)
+        {
+        }
+
+        ~ObjectPool()
+        {
+            for (size_t i = 0; i < m_blocks.size(); ++i)
+            {
+                delete m_blocks[i];
+            }
+        }
+
+        T * construct()
+        {
+            Block * block = acquire();
+            try
+            {
+                return new (&block->storage) T();
+            }
+            catch (...)
+            {
+                release(block);
+                throw;
+            }
+        }
+
+        void destroy(T * object)
+        {
+            object->~T();
+            release(reinterpret_cast<Block *>(object));
+        }
+
+        /**
+         * Number of blocks allocated so far; the most objects ever alive at once.
+         */
+        size_t capacity() const
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            return m_blocks.size();
+        }
+
+    private:
+        union Block
+        {
+            typename std::aligned_storage<sizeof(T), std::alignment_of<T>::value>::type storage;
+            Block * next;
+        };
+
+        Block * acquire()
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            Block * block = m_free;
+            if (block != NULL)
+            {
+                m_free = block->next;
+                return block;
+            }
+            block = new Block;
+            m_blocks.push_back(block);
+            return block;
+        }
+
+        void release(Block * block)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            block->next = m_free;
+            m_free = block;
+        }
+
+        ObjectPool(const ObjectPool &);
+        ObjectPool & operator = (const ObjectPool &);
+
+        Block * m_free;
+        std::vector<Block *> m_blocks;
+        mutable std::mutex m_mutex;
+};
+
+#endif //
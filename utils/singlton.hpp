@@ -1,33 +1,83 @@
 #ifndef __SINGLTON_HPP__
 #define __SINGLTON_HPP__
 
-template <class T> 
+#include <atomic>
+#include <mutex>
+
+/**
+ * Base class of the framework's Singletons.
+ *
+ * <P>
+ * <code>getInstance</code> may be called from any thread. The instance
+ * is created under a lock the first time; after that a call is one
+ * acquire load of the instance pointer, which is a plain load on x86,
+ * and takes no lock.</P>
+ *
+ * <P>
+ * <code>destroyInstance</code> deletes the instance so that the next
+ * <code>getInstance</code> builds a new one. No other thread may be
+ * using the instance while it is destroyed.</P>
+ */
+template <class T>
 class Singlton
 {
     protected:
 		Singlton()  {}
     public:
-        static T* getInstance() 
-        {   
-            if (s_ins == 0) 
-            { 
-                //s_ins = new(s_insbuf)T(); 
-                s_ins = new T(); 
+        static T* getInstance()
+        {
+            T * ins = s_ins.load(std::memory_order_acquire);
+            if (ins == 0)
+            {
+                ins = createInstance();
+            }
+            return ins;
+        }
+
+        /**
+         * Delete the instance, if any.
+         */
+        static void destroyInstance()
+        {
+            T * ins = 0;
+            {
+                std::lock_guard<std::mutex> lock(getMutex());
+                ins = s_ins.exchange(0, std::memory_order_acq_rel);
             }
-            return s_ins; 
+            delete ins;
+        }
+
+        static bool hasInstance()
+        {
+            return s_ins.load(std::memory_order_acquire) != 0;
         }
 
         ~Singlton()
         {
-            //if (s_ins) { s_ins->~T(); }
         }
     private:
-        static T * s_ins ;
-        //static char  s_insbuf[sizeof(T)];
+        static T* createInstance()
+        {
+            std::lock_guard<std::mutex> lock(getMutex());
+            T * ins = s_ins.load(std::memory_order_relaxed);
+            if (ins == 0)
+            {
+                ins = new T();
+                s_ins.store(ins, std::memory_order_release);
+            }
+            return ins;
+        }
+
+        static std::mutex & getMutex()
+        {
+            static std::mutex s_mutex;
+            return s_mutex;
+        }
+
+        static std::atomic<T *> s_ins ;
 };
 
-//template <class T> char Singlton<T>::s_insbuf[sizeof(T)];
-template <class T> T* Singlton<T>::s_ins =0; 
+template <class T> std::atomic<T *> Singlton<T>::s_ins(0);
 
 
-#endif // 
+#endif //
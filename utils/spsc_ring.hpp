@@ -0,0 +1,117 @@
+#ifndef __SPSC_RING_HPP__
+#define __SPSC_RING_HPP__
+
+#include <atomic>
+#include <vector>
+#include <cstddef>
+
+/**
+ * A bounded lock-free FIFO between exactly one producer thread and one
+ * consumer thread.
+ *
+ * <P>
+ * Slots are allocated once and reused, so pushing and popping never
+ * touch the heap. The producer owns <code>m_tail</code> and the consumer
+ * owns <code>m_head</code>; each keeps a cached copy of the other's
+ * index and only reloads it when the ring looks full or empty, so in
+ * steady state a push or pop is one store to a line nobody else writes.</P>
+ *
+ * <P>
+ * <code>tryPush</code> may only be called from the producer thread and
+ * <code>tryPop</code> only from the consumer thread.</P>
+ */
+template <class T>
+class SpscRing
+{
+    public:
+        /**
+         * @param capacity rounded up to a power of two
+         * @param init value the slots are initialised with
+         */
+        explicit SpscRing(size_t capacity = 1024, const T & init = T())
+            :m_head(0), m_cachedTail(0), m_tail(0), m_cachedHead(0)
+        {
+            size_t size = 2;
+            while (size < capacity)
+                size <<= 1;
+            m_mask = size - 1;
+            m_slots.assign(size, init);
+        }
+
+        /**
+         * Append an item.
+         *
+         * @return false if the ring is full.
+         */
+        bool tryPush(const T & item)
+        {
+            size_t tail = m_tail.load(std::memory_order_relaxed);
+            if (tail - m_cachedHead > m_mask)
+            {
+                m_cachedHead = m_head.load(std::memory_order_acquire);
+                if (tail - m_cachedHead > m_mask)
+                    return false;
+            }
+            m_slots[tail & m_mask] = item;
+            m_tail.store(tail + 1, std::memory_order_release);
+            return true;
+        }
+
+        /**
+         * Take the oldest item.
+         *
+         * @return false if the ring is empty.
+         */
+        bool tryPop(T & item)
+        {
+            size_t head = m_head.load(std::memory_order_relaxed);
+            if (head == m_cachedTail)
+            {
+                m_cachedTail = m_tail.load(std::memory_order_acquire);
+                if (head == m_cachedTail)
+                    return false;
+            }
+            item = m_slots[head & m_mask];
+            m_head.store(head + 1, std::memory_order_release);
+            return true;
+        }
+
+        /**
+         * Whether the ring looked empty; exact only on the consumer thread.
+         */
+        bool empty() const
+        {
+            return m_head.load(std::memory_order_acquire) == m_tail.load(std::memory_order_acquire);
+        }
+
+        size_t capacity() const
+        {
+            return m_mask + 1;
+        }
+
+    private:
+        SpscRing(const SpscRing &);
+        SpscRing & operator = (const SpscRing &);
+
+        enum { CACHE_LINE = 64 };
+
+        std::vector<T> m_slots;
+        size_t m_mask;
+
+        // Whole lines of padding around each side rather than alignas:
+        // new of an over-aligned type needs C++17, and the ring may
+        // start anywhere in a line
+        char m_pad0[CACHE_LINE];
+
+        // consumer side
+        std::atomic<size_t> m_head;
+        size_t m_cachedTail;
+        char m_pad1[CACHE_LINE];
+
+        // producer side
+        std::atomic<size_t> m_tail;
+        size_t m_cachedHead;
+        char m_pad2[CACHE_LINE];
+};
+
+#endif //
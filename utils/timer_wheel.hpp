@@ -0,0 +1,352 @@
+#ifndef __TIMER_WHEEL_HPP__
+#define __TIMER_WHEEL_HPP__
+
+#include <algorithm>
+#include <chrono>
+#include <vector>
+#include <cstddef>
+#include <stdint.h>
+
+/**
+ * Handle of a timer scheduled in a <code>TimerWheel</code>.
+ */
+struct TimerId
+{
+    TimerId()
+        :index(0), generation(0)
+    {
+    }
+
+    TimerId(uint32_t i, uint32_t g)
+        :index(i), generation(g)
+    {
+    }
+
+    bool isValid() const
+    {
+        return generation != 0;
+    }
+
+    bool operator == (const TimerId & other) const
+    {
+        return index == other.index && generation == other.generation;
+    }
+
+    uint32_t index;
+    uint32_t generation;
+};
+
+/**
+ * A hierarchical timing wheel holding timers that carry a <code>T</code>.
+ *
+ * <P>
+ * Time is counted in ticks of a fixed resolution. Level 0 has one slot
+ * per tick for the next 256 ticks, and each further level has slots
+ * 256 times as wide, so four levels cover 2^32 ticks; timers further
+ * out are clamped to the last slot. A timer goes into the slot of the
+ * lowest level that can hold its expiry; when time reaches a slot of a
+ * higher level, its timers cascade down a level. Each timer therefore
+ * moves at most three times, and scheduling and cancelling are O(1):
+ * timers live in a pool of nodes linked into their slot, and a
+ * <code>TimerId</code> names a node plus a generation that changes
+ * whenever the node is reused.</P>
+ *
+ * <P>
+ * <code>advance</code> walks the ticks up to <code>now</code> and calls
+ * <code>fire</code> for every timer that expired, in expiry order. A
+ * periodic timer is rescheduled one period after the tick it fired on.
+ * <code>fire</code> must not schedule or cancel timers, and the wheel
+ * is not thread-safe.</P>
+ */
+template <class T>
+class TimerWheel
+{
+    public:
+        typedef std::chrono::steady_clock Clock;
+
+        enum { LEVELS = 4, SLOT_BITS = 8, SLOTS = 1 << SLOT_BITS };
+
+        /**
+         * @param resolution length of a tick
+         * @param start the time of tick 0
+         * @param empty the payload of unused nodes
+         */
+        explicit TimerWheel(Clock::duration resolution = std::chrono::milliseconds(1),
+                Clock::time_point start = Clock::now(), const T & empty = T())
+            :m_resolution(resolution.count() > 0 ? resolution : Clock::duration(1)),
+             m_start(start), m_now(0), m_size(0), m_free(NIL), m_empty(empty)
+        {
+            for (size_t i = 0; i < LEVELS * SLOTS; ++i)
+                m_slots[i] = NIL;
+        }
+
+        /**
+         * Schedule a timer.
+         *
+         * @param payload passed to <code>fire</code> when the timer expires
+         * @param due when the timer expires; at the earliest on the next tick
+         * @param period interval of a periodic timer, zero for a one-shot one
+         * @return the handle to cancel the timer with
+         */
+        TimerId schedule(const T & payload, Clock::time_point due, Clock::duration period = Clock::duration(0))
+        {
+            uint32_t index = allocate();
+            Node & node = m_nodes[index];
+            node.payload = payload;
+            node.period = 0;
+            if (period.count() > 0)
+                node.period = std::max<uint64_t>(1, ticksFor(period));
+            node.when = std::max(m_now + 1, tickOf(due));
+            link(index);
+            ++m_size;
+            return TimerId(index, node.generation);
+        }
+
+        /**
+         * Schedule a timer <code>delay</code> after the later of
+         * <code>now</code> and the time the wheel has been advanced to,
+         * so that delays stay relative to the wheel's time when it is
+         * driven ahead of the clock.
+         *
+         * @param payload passed to <code>fire</code> when the timer expires
+         * @param delay time until the timer expires, rounded up to whole ticks
+         * @param period interval of a periodic timer, zero for a one-shot one
+         * @param now the current time
+         * @return the handle to cancel the timer with
+         */
+        TimerId scheduleAfter(const T & payload, Clock::duration delay, Clock::duration period, Clock::time_point now)
+        {
+            uint64_t base = std::max(tickOf(now), m_now);
+            return schedule(payload, m_start + m_resolution * (base + ticksFor(delay)), period);
+        }
+
+        /**
+         * Cancel a timer.
+         *
+         * @return false if the timer already fired, was cancelled or is unknown.
+         */
+        bool cancel(const TimerId & timer)
+        {
+            if (!timer.isValid() || timer.index >= m_nodes.size())
+                return false;
+            Node & node = m_nodes[timer.index];
+            if (node.generation != timer.generation || node.slot == NIL)
+                return false;
+            unlink(timer.index);
+            release(timer.index);
+            --m_size;
+            return true;
+        }
+
+        /**
+         * Fire every timer that expired by <code>now</code>.
+         *
+         * @param now the current time
+         * @param fire called as <code>fire(payload)</code> for each expired timer
+         * @return the number of timers fired
+         */
+        template <class F>
+        size_t advance(Clock::time_point now, F & fire)
+        {
+            uint64_t target = tickOf(now);
+            size_t fired = 0;
+            while (m_now < target)
+            {
+                if (m_size == 0)
+                {
+                    m_now = target;
+                    break;
+                }
+                ++m_now;
+                cascade();
+                fired += expire(fire);
+            }
+            return fired;
+        }
+
+        /**
+         * Number of timers scheduled.
+         */
+        size_t size() const
+        {
+            return m_size;
+        }
+
+        /**
+         * The last tick <code>advance</code> reached.
+         */
+        uint64_t now() const
+        {
+            return m_now;
+        }
+
+        Clock::duration resolution() const
+        {
+            return m_resolution;
+        }
+
+    private:
+        static const uint32_t NIL = 0xffffffffu;
+
+        struct Node
+        {
+            explicit Node(const T & empty)
+                :payload(empty), when(0), period(0), prev(NIL), next(NIL), slot(NIL), generation(1)
+            {
+            }
+
+            T payload;
+            uint64_t when;
+            uint64_t period;
+            uint32_t prev;
+            uint32_t next;
+            // the slot the node is linked into, NIL while free
+            uint32_t slot;
+            uint32_t generation;
+        };
+
+        uint64_t ticksFor(Clock::duration duration) const
+        {
+            if (duration.count() <= 0)
+                return 0;
+            return (uint64_t)((duration + m_resolution - Clock::duration(1)) / m_resolution);
+        }
+
+        uint64_t tickOf(Clock::time_point time) const
+        {
+            return ticksFor(time - m_start);
+        }
+
+        uint32_t allocate()
+        {
+            if (m_free != NIL)
+            {
+                uint32_t index = m_free;
+                m_free = m_nodes[index].next;
+                return index;
+            }
+            m_nodes.push_back(Node(m_empty));
+            return (uint32_t)(m_nodes.size() - 1);
+        }
+
+        void release(uint32_t index)
+        {
+            Node & node = m_nodes[index];
+            node.payload = m_empty;
+            node.slot = NIL;
+            if (++node.generation == 0)
+                node.generation = 1;
+            node.next = m_free;
+            m_free = index;
+        }
+
+        // Put a node into the slot of the lowest level covering its expiry
+        void link(uint32_t index)
+        {
+            Node & node = m_nodes[index];
+            uint64_t delta = node.when - m_now;
+            uint64_t when = node.when;
+            size_t level = 0;
+            while (level + 1 < LEVELS && delta >= ((uint64_t)1 << (SLOT_BITS * (level + 1))))
+                ++level;
+            if (level == LEVELS - 1 && delta >= ((uint64_t)1 << (SLOT_BITS * LEVELS)))
+                when = m_now + ((uint64_t)1 << (SLOT_BITS * LEVELS)) - 1;
+
+            uint32_t slot = (uint32_t)(level * SLOTS + ((when >> (SLOT_BITS * level)) & (SLOTS - 1)));
+            node.slot = slot;
+            node.prev = NIL;
+            node.next = m_slots[slot];
+            if (node.next != NIL)
+                m_nodes[node.next].prev = index;
+            m_slots[slot] = index;
+        }
+
+        void unlink(uint32_t index)
+        {
+            Node & node = m_nodes[index];
+            if (node.prev != NIL)
+                m_nodes[node.prev].next = node.next;
+            else
+                m_slots[node.slot] = node.next;
+            if (node.next != NIL)
+                m_nodes[node.next].prev = node.prev;
+            node.prev = node.next = NIL;
+        }
+
+        // Detach the whole list of a slot
+        uint32_t take(uint32_t slot)
+        {
+            uint32_t head = m_slots[slot];
+            m_slots[slot] = NIL;
+            return head;
+        }
+
+        // Move the timers of every higher level slot that starts at this
+        // tick down to the levels below
+        void cascade()
+        {
+            for (size_t level = 1; level < LEVELS; ++level)
+            {
+                uint64_t shift = SLOT_BITS * level;
+                if ((m_now & (((uint64_t)1 << shift) - 1)) != 0)
+                    break;
+                uint32_t index = take((uint32_t)(level * SLOTS + ((m_now >> shift) & (SLOTS - 1))));
+                while (index != NIL)
+                {
+                    uint32_t next = m_nodes[index].next;
+                    link(index);
+                    index = next;
+                }
+            }
+        }
+
+        // Fire the level 0 slot of the current tick
+        template <class F>
+        size_t expire(F & fire)
+        {
+            size_t fired = 0;
+            uint32_t index = take((uint32_t)(m_now & (SLOTS - 1)));
+            while (index != NIL)
+            {
+                Node & node = m_nodes[index];
+                uint32_t next = node.next;
+                if (node.when > m_now)
+                {
+                    // clamped beyond the wheel's range; not due yet
+                    link(index);
+                    index = next;
+                    continue;
+                }
+                fire(node.payload);
+                ++fired;
+                if (node.period != 0)
+                {
+                    node.when = m_now + node.period;
+                    link(index);
+                }
+                else
+                {
+                    release(index);
+                    --m_size;
+                }
+                index = next;
+            }
+            return fired;
+        }
+
+        TimerWheel(const TimerWheel &);
+        TimerWheel & operator = (const TimerWheel &);
+
+        Clock::duration m_resolution;
+        Clock::time_point m_start;
+        // the last tick processed
+        uint64_t m_now;
+        size_t m_size;
+        // head of the list of free nodes, linked through next
+        uint32_t m_free;
+        std::vector<Node> m_nodes;
+        T m_empty;
+        uint32_t m_slots[LEVELS * SLOTS];
+};
+
+#endif //
@@ -1,7 +1,7 @@
 #ifndef __TYPE_TO_INDEX_HPP__ 
 #define __TYPE_TO_INDEX_HPP__ 
 
-#include "hash_map.hpp"
+#include "hash_func.hpp"
 #include <vector>
 
 using namespace HASH_MAP_NAMESPACE; 
@@ -13,21 +13,39 @@ struct TypeItem
 	T name; 
 };
 
+/**
+ * Map values of type <code>T</code> to dense integer indexes.
+ *
+ * <P>
+ * Index 0 is reserved and means "unknown", so the first value
+ * registered gets index 1. Indexes are never reused, which makes
+ * them suitable as keys into flat arrays.</P>
+ */
 template <class T> 
 class TypeToIndex 
 {
 public:
 
     typedef std::vector<TypeItem<T> > TypeItemVector; 
-    typedef TypeItemVector::iterator TypeItemVectorItr; 
+    typedef typename TypeItemVector::iterator TypeItemVectorItr; 
 
     typedef hash_map<T,int>  TypeItemMap; 
-    typedef TypeItemMap::iterator TypeItemMapItr; 
+    typedef typename TypeItemMap::iterator TypeItemMapItr; 
+    typedef typename TypeItemMap::const_iterator TypeItemMapConstItr;
 
+	TypeToIndex()
+	{
+		TypeItem<T> unknown;
+		unknown.bUsed = false;
+		m_typeVec.push_back(unknown);
+	}
 
-	int getTypeIndex(const T & t)
+	/**
+	 * Get the index of a value, or 0 if it was never registered.
+	 */
+	int getTypeIndex(const T & t) const
 	{
-        TypeItemMapItr itr = m_typeMap.find (t);
+        TypeItemMapConstItr itr = m_typeMap.find (t);
         if (itr != m_typeMap.end())
         {
             return itr->second; 
@@ -36,29 +54,53 @@ public:
 
 	}
 
-	T  getIndexType(int idx)
+	/**
+	 * Get the index of a value, registering it if necessary.
+	 */
+	int registerType(const T & t)
 	{
-		if (idx < m_typeVec.size())
-		{
-			return m_typeVec[idx]; 
-		}
-		return T(); 
+        TypeItemMapItr itr = m_typeMap.find (t);
+        if (itr != m_typeMap.end())
+        {
+            return itr->second;
+        }
+
+		TypeItem<T> item;
+		item.bUsed = true;
+		item.name = t;
+		int idx = (int)m_typeVec.size();
+		m_typeVec.push_back(item);
+		m_typeMap[t] = idx;
+		return idx;
 	}
 
-	T operator [](int idx)
+	T  getIndexType(int idx) const
 	{
-		if (idx < m_typeVec.size())
+		if (idx > 0 && idx < (int)m_typeVec.size())
 		{
-			return m_typeVec[idx]; 
+			return m_typeVec[idx].name; 
 		}
 		return T(); 
 	}
 
-    int operator ()(const T& t)
+	T operator [](int idx) const
+	{
+		return getIndexType(idx);
+	}
+
+    int operator ()(const T& t) const
     {
         return getTypeIndex(t); 
     }
 
+	/**
+	 * Number of slots, including the reserved index 0.
+	 */
+	size_t size() const
+	{
+		return m_typeVec.size();
+	}
+
 private:
 	TypeItemVector m_typeVec; 
     TypeItemMap m_typeMap; 
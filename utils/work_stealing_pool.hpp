@@ -0,0 +1,422 @@
+#ifndef __WORK_STEALING_POOL_HPP__
+#define __WORK_STEALING_POOL_HPP__
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <cstddef>
+#include <stdint.h>
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+#include "singlton.hpp"
+
+/**
+ * A pool of worker threads that balance load by stealing tasks.
+ *
+ * <P>
+ * A task is a function pointer and its argument, so submitting one
+ * never allocates. Every worker owns a Chase-Lev deque: tasks a worker
+ * submits go onto the bottom of its own deque and it takes them back
+ * from there, newest first, while idle workers steal the oldest task
+ * from the top of a random victim's deque. Tasks submitted by threads
+ * outside the pool, and tasks that do not fit a full deque, go to a
+ * shared injection queue under a mutex.</P>
+ *
+ * <P>
+ * Workers that find nothing to run park on a condition variable and
+ * are woken one at a time as tasks arrive. <code>waitFor</code> lets
+ * any thread, including a worker waiting on tasks it submitted, run
+ * pending tasks until a counter drops to zero, so nested waits cannot
+ * starve the pool.</P>
+ *
+ * <P>
+ * <code>WorkStealingPool::getInstance()</code> is a shared pool with
+ * one worker per hardware thread; the <code>Controller</code>'s async
+ * commands, the Facade's pooled async dispatch and
+ * <code>ParallelMacroCommand</code> all default to it, so they share
+ * one set of threads instead of each starting their own. Workers can
+ * be pinned to CPUs with <code>pinWorkers</code>. Tasks must not
+ * throw.</P>
+ */
+class WorkStealingPool : public Singlton<WorkStealingPool>
+{
+    public:
+        typedef void (*TaskFunction)(void *);
+
+        /**
+         * Start the workers.
+         *
+         * @param threads number of workers, 0 for one per hardware thread
+         * @param capacity bound of each worker's deque, rounded up to a power of two
+         */
+        explicit WorkStealingPool(size_t threads = 0, size_t capacity = 4096)
+            :m_injectedSize(0), m_queued(0), m_idle(0), m_running(true)
+        {
+            if (threads == 0)
+                threads = std::thread::hardware_concurrency();
+            if (threads == 0)
+                threads = 1;
+            for (size_t i = 0; i < threads; ++i)
+            {
+                m_deques.push_back(new TaskDeque(capacity));
+            }
+            for (size_t i = 0; i < threads; ++i)
+            {
+                m_workers.push_back(std::thread(&WorkStealingPool::run, this, i));
+            }
+        }
+
+        /**
+         * Run every task already submitted, then join the workers.
+         */
+        ~WorkStealingPool()
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_parkMutex);
+                m_running.store(false);
+            }
+            m_wakeup.notify_all();
+            for (size_t i = 0; i < m_workers.size(); ++i)
+            {
+                m_workers[i].join();
+            }
+            for (size_t i = 0; i < m_deques.size(); ++i)
+            {
+                delete m_deques[i];
+            }
+        }
+
+        size_t size() const
+        {
+            return m_workers.size();
+        }
+
+        /**
+         * Pin worker <code>i</code> to CPU <code>cpus[i % cpus.size()]</code>.
+         *
+         * @return false if affinity is not supported here or a CPU was refused
+         */
+        bool pinWorkers(const std::vector<int> & cpus)
+        {
+            if (cpus.empty())
+                return false;
+#ifdef __linux__
+            bool pinned = true;
+            for (size_t i = 0; i < m_workers.size(); ++i)
+            {
+                cpu_set_t set;
+                CPU_ZERO(&set);
+                CPU_SET(cpus[i % cpus.size()], &set);
+                if (pthread_setaffinity_np(m_workers[i].native_handle(), sizeof(set), &set) != 0)
+                    pinned = false;
+            }
+            return pinned;
+#else
+            return false;
+#endif
+        }
+
+        /**
+         * Queue <code>function(argument)</code> to run on a worker.
+         */
+        void submit(TaskFunction function, void * argument)
+        {
+            Task task = { function, argument };
+            m_queued.fetch_add(1);
+            WorkerSlot & slot = currentSlot();
+            if (slot.pool != this || !m_deques[slot.index]->push(task))
+            {
+                std::lock_guard<std::mutex> lock(m_injectMutex);
+                m_injected.push_back(task);
+                m_injectedSize.store(m_injected.size());
+            }
+            if (m_idle.load() > 0)
+            {
+                // a worker counted idle is either waiting or will see
+                // m_queued once it holds m_parkMutex
+                {
+                    std::lock_guard<std::mutex> lock(m_parkMutex);
+                }
+                m_wakeup.notify_one();
+            }
+        }
+
+        /**
+         * Run one pending task on the calling thread, if there is one.
+         *
+         * @return whether a task was run
+         */
+        bool runOne()
+        {
+            Task task;
+            WorkerSlot & slot = currentSlot();
+            size_t self = slot.pool == this ? slot.index : m_deques.size();
+            if (!take(self, task))
+                return false;
+            task.function(task.argument);
+            return true;
+        }
+
+        /**
+         * Run pending tasks on the calling thread until
+         * <code>remaining</code> is zero.
+         */
+        void waitFor(const std::atomic<size_t> & remaining)
+        {
+            while (remaining.load(std::memory_order_acquire) != 0)
+            {
+                if (!runOne())
+                    std::this_thread::yield();
+            }
+        }
+
+        /**
+         * The pool whose worker is calling, or NULL.
+         */
+        static WorkStealingPool * current()
+        {
+            return currentSlot().pool;
+        }
+
+    private:
+        struct Task
+        {
+            TaskFunction function;
+            void * argument;
+        };
+
+        // Chase-Lev deque of a fixed capacity. The owner pushes and pops
+        // at the bottom; any thread steals from the top. Slots are
+        // atomics so that a thief reading a slot the owner is reusing
+        // is not a data race; such a thief always loses the CAS on top
+        // and discards what it read.
+        class TaskDeque
+        {
+            public:
+                explicit TaskDeque(size_t capacity)
+                    :m_top(0), m_bottom(0)
+                {
+                    size_t size = 2;
+                    while (size < capacity)
+                        size <<= 1;
+                    m_mask = size - 1;
+                    m_functions = new std::atomic<TaskFunction>[size];
+                    m_arguments = new std::atomic<void *>[size];
+                    for (size_t i = 0; i < size; ++i)
+                    {
+                        m_functions[i].store(NULL, std::memory_order_relaxed);
+                        m_arguments[i].store(NULL, std::memory_order_relaxed);
+                    }
+                }
+
+                ~TaskDeque()
+                {
+                    delete [] m_functions;
+                    delete [] m_arguments;
+                }
+
+                // Owner only; false if the deque is full
+                bool push(const Task & task)
+                {
+                    int64_t bottom = m_bottom.load(std::memory_order_relaxed);
+                    int64_t top = m_top.load();
+                    if (bottom - top > (int64_t)m_mask)
+                        return false;
+                    m_functions[bottom & m_mask].store(task.function, std::memory_order_relaxed);
+                    m_arguments[bottom & m_mask].store(task.argument, std::memory_order_relaxed);
+                    m_bottom.store(bottom + 1);
+                    return true;
+                }
+
+                // Owner only
+                bool pop(Task & task)
+                {
+                    int64_t bottom = m_bottom.load(std::memory_order_relaxed) - 1;
+                    m_bottom.store(bottom);
+                    int64_t top = m_top.load();
+                    if (top > bottom)
+                    {
+                        m_bottom.store(bottom + 1);
+                        return false;
+                    }
+                    read(bottom, task);
+                    if (top == bottom)
+                    {
+                        // the last task; race the thieves for it
+                        bool won = m_top.compare_exchange_strong(top, top + 1);
+                        m_bottom.store(bottom + 1);
+                        return won;
+                    }
+                    return true;
+                }
+
+                // Any thread
+                bool steal(Task & task)
+                {
+                    int64_t top = m_top.load();
+                    int64_t bottom = m_bottom.load();
+                    if (top >= bottom)
+                        return false;
+                    read(top, task);
+                    return m_top.compare_exchange_strong(top, top + 1);
+                }
+
+                bool empty() const
+                {
+                    return m_top.load() >= m_bottom.load();
+                }
+
+            private:
+                void read(int64_t index, Task & task) const
+                {
+                    task.function = m_functions[index & m_mask].load(std::memory_order_relaxed);
+                    task.argument = m_arguments[index & m_mask].load(std::memory_order_relaxed);
+                }
+
+                TaskDeque(const TaskDeque &);
+                TaskDeque & operator = (const TaskDeque &);
+
+                enum { CACHE_LINE = 64 };
+
+                std::atomic<TaskFunction> * m_functions;
+                std::atomic<void *> * m_arguments;
+                size_t m_mask;
+
+                // thieves write m_top and the owner m_bottom: whole lines of
+                // padding keep them apart without alignas, whose
+                // over-aligned new needs C++17
+                char m_pad0[CACHE_LINE];
+                std::atomic<int64_t> m_top;
+                char m_pad1[CACHE_LINE];
+                std::atomic<int64_t> m_bottom;
+                char m_pad2[CACHE_LINE];
+        };
+
+        struct WorkerSlot
+        {
+            WorkStealingPool * pool;
+            size_t index;
+        };
+
+        static WorkerSlot & currentSlot()
+        {
+            static thread_local WorkerSlot s_slot = { NULL, 0 };
+            return s_slot;
+        }
+
+        // Own deque first, then the injection queue, then the others
+        // starting at a per-thread random victim. self is the caller's
+        // deque, or m_deques.size() outside the pool.
+        bool take(size_t self, Task & task)
+        {
+            if (!find(self, task))
+                return false;
+            m_queued.fetch_sub(1);
+            return true;
+        }
+
+        bool find(size_t self, Task & task)
+        {
+            if (self < m_deques.size() && m_deques[self]->pop(task))
+                return true;
+            if (m_injectedSize.load() != 0)
+            {
+                std::lock_guard<std::mutex> lock(m_injectMutex);
+                if (!m_injected.empty())
+                {
+                    task = m_injected.front();
+                    m_injected.pop_front();
+                    m_injectedSize.store(m_injected.size());
+                    return true;
+                }
+            }
+            size_t count = m_deques.size();
+            size_t start = (size_t)(nextRandom() % count);
+            for (size_t i = 0; i < count; ++i)
+            {
+                size_t victim = (start + i) % count;
+                if (victim != self && m_deques[victim]->steal(task))
+                    return true;
+            }
+            return false;
+        }
+
+        static uint32_t nextRandom()
+        {
+            static thread_local uint32_t s_state = 0;
+            if (s_state == 0)
+                s_state = (uint32_t)(size_t)&s_state | 1;
+            s_state ^= s_state << 13;
+            s_state ^= s_state >> 17;
+            s_state ^= s_state << 5;
+            return s_state;
+        }
+
+        void run(size_t index)
+        {
+            WorkerSlot & slot = currentSlot();
+            slot.pool = this;
+            slot.index = index;
+
+            Task task;
+            for (;;)
+            {
+                if (take(index, task))
+                {
+                    task.function(task.argument);
+                    continue;
+                }
+                // Count ourselves idle before the last look at m_queued:
+                // a submitter that queued a task before seeing m_idle as
+                // zero is seen here, and one that sees us idle notifies
+                std::unique_lock<std::mutex> lock(m_parkMutex);
+                m_idle.fetch_add(1);
+                bool queued = m_queued.load() != 0;
+                if (!queued)
+                {
+                    if (!m_running.load())
+                    {
+                        m_idle.fetch_sub(1);
+                        break;
+                    }
+                    m_wakeup.wait(lock);
+                }
+                m_idle.fetch_sub(1);
+                if (queued)
+                {
+                    // counted but not pushed yet
+                    lock.unlock();
+                    std::this_thread::yield();
+                }
+            }
+            slot.pool = NULL;
+        }
+
+        WorkStealingPool(const WorkStealingPool &);
+        WorkStealingPool & operator = (const WorkStealingPool &);
+
+        std::vector<TaskDeque *> m_deques;
+        std::vector<std::thread> m_workers;
+
+        // tasks submitted from outside the pool or that overflowed a deque
+        std::mutex m_injectMutex;
+        std::deque<Task> m_injected;
+        // size of m_injected, read without the lock
+        std::atomic<size_t> m_injectedSize;
+
+        // tasks submitted and not yet taken by any thread
+        std::atomic<size_t> m_queued;
+
+        // parking of idle workers
+        std::mutex m_parkMutex;
+        std::condition_variable m_wakeup;
+        std::atomic<size_t> m_idle;
+        std::atomic<bool> m_running;
+};
+
+#endif //